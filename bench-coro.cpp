@@ -0,0 +1,98 @@
+/**
+ * Coroutine scheduler benchmark.
+ *
+ * 1. Context switch rate: tasks that only co_await priq::yield.
+ * 2. Timer accuracy: many concurrent sleepers with random deadlines,
+ *    reports how late they were resumed.
+ * Usage: bench-coro [sleepers] [rounds]
+ */
+
+/* ---- System Header ------------------------------------------------------------ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/* ---- DOT Header --------------------------------------------------------------- */
+#include "priq_sched.hpp"
+
+/* ---- Help funcs & macros ------------------------------------------------------ */
+using namespace std::chrono;
+
+static double to_sec(priq::clock::duration d)
+{
+	return duration<double>(d).count();
+}
+
+/* ---- Benchmark ---------------------------------------------------------------- */
+
+priq::task yielder(uint64_t n, int64_t prio)
+{
+	for(uint64_t i = 0; i < n; ++i)
+		co_await priq::yield(prio);
+}
+
+priq::task sleeper(uint64_t rounds, uint32_t seed, std::vector<int64_t>& late)
+{
+	for(uint64_t i = 0; i < rounds; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		auto deadline = priq::clock::now() + microseconds(1000 + (seed >> 8) % 100000);
+
+		co_await priq::sleep_until(deadline);
+
+		late.push_back(duration_cast<nanoseconds>(priq::clock::now() - deadline).count());
+	}
+}
+
+static void bench_switch(uint64_t tasks, uint64_t yields)
+{
+	priq::scheduler s;
+
+	for(uint64_t i = 0; i < tasks; ++i)
+		s.spawn(yielder(yields, i % 16));
+
+	auto t = priq::clock::now();
+	s.run();
+	double sec = to_sec(priq::clock::now() - t);
+
+	printf("switch: %8lu tasks x %lu yields  %10.0f switches/s  %6.1f ns/switch\n",
+		(unsigned long)tasks, (unsigned long)yields,
+		s.switches() / sec, sec * 1e9 / s.switches());
+}
+
+static void bench_timer(uint64_t sleepers, uint64_t rounds)
+{
+	priq::scheduler s;
+	std::vector<int64_t> late;
+	late.reserve(sleepers * rounds);
+
+	for(uint64_t i = 0; i < sleepers; ++i)
+		s.spawn(sleeper(rounds, (uint32_t)i, late));
+
+	auto t = priq::clock::now();
+	s.run();
+	double sec = to_sec(priq::clock::now() - t);
+
+	std::sort(late.begin(), late.end());
+	auto pct = [&](double p) { return late[(size_t)(p * (late.size() - 1))] / 1e3; };
+
+	printf("timer:  %8lu sleepers x %lu rounds  %.2f s  %10.0f wakeups/s\n",
+		(unsigned long)sleepers, (unsigned long)rounds, sec, late.size() / sec);
+	printf("        lateness us  p50 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+		pct(0.5), pct(0.99), pct(0.999), pct(1.0));
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t sleepers = (argc > 1) ? strtoull(argv[1], NULL, 10) : 1000000;
+	uint64_t rounds = (argc > 2) ? strtoull(argv[2], NULL, 10) : 3;
+
+	bench_switch(1000, 10000);
+	bench_switch(sleepers, 10);
+	bench_timer(sleepers, rounds);
+
+	return 0;
+}
@@ -0,0 +1,11 @@
+#!/bin/bash
+
+TARGET="bench-coro"
+SRC="bench-coro.cpp"
+
+## FLAGS
+CXXFLAGS="-O2 -std=c++20 -pipe -Wall -Wextra -Werror -pthread"
+LDLIBS="libpriq.a"
+CXX="g++"
+
+make && $CXX $CXXFLAGS -o $TARGET $SRC $LDLIBS && ./$TARGET "$@"
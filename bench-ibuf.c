@@ -0,0 +1,114 @@
+/**
+ * Insertion buffer benchmark.
+ *
+ * hold: the classic hold model, dequeue the top and enqueue it again
+ *       with a random increment.
+ * lifo: bursts of elements smaller than the top, dequeued right away.
+ * Both run with the insertion buffer off and at several capacities.
+ * Usage: bench-ibuf [queue size] [operations]
+ */
+
+/* ---- System Header ------------------------------------------------------------ */
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* ---- DOT Header --------------------------------------------------------------- */
+#include "priq.h"
+
+/* ---- Help funcs & macros ------------------------------------------------------ */
+#define KEY(c) ((uintptr_t)(c))
+#define ELEM(k) ((void*)(uintptr_t)(k))
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static inline uint64_t rnd( uint64_t* s )
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+/* ---- Benchmark ---------------------------------------------------------------- */
+
+int key_cmp( void* e1, void* e2 )
+{
+	return ( ( KEY( e1 ) >= KEY( e2 ) ) - ( KEY( e2 ) >= KEY( e1 ) ) );
+}
+
+static Priq prefill( unsigned buffer, uint64_t n, uint64_t* seed )
+{
+	Priq q = priq_create( key_cmp );
+	priq_insertion_buffer( q, buffer );
+
+	for( uint64_t i = 0; i < n; ++i )
+		priq_enqueue( q, ELEM( ( 1ULL << 40 ) + rnd( seed ) % ( 1ULL << 32 ) ) );
+
+	return q;
+}
+
+static double hold( unsigned buffer, uint64_t n, uint64_t ops )
+{
+	uint64_t seed = 88172645463325252ULL;
+	Priq q = prefill( buffer, n, &seed );
+
+	double t = now( );
+	for( uint64_t i = 0; i < ops; ++i )
+	{
+		uintptr_t k = KEY( priq_dequeue( q ) );
+		priq_enqueue( q, ELEM( k + 1 + rnd( &seed ) % ( 1ULL << 20 ) ) );
+	}
+	t = now( ) - t;
+
+	priq_destroy( q, NULL );
+	return t * 1e9 / ( 2 * ops );
+}
+
+static double lifo( unsigned buffer, uint64_t n, uint64_t ops )
+{
+	uint64_t seed = 88172645463325252ULL;
+	Priq q = prefill( buffer, n, &seed );
+	uint64_t done = 0;
+
+	double t = now( );
+	while( done < ops )
+	{
+		unsigned burst = 1 + rnd( &seed ) % 8;
+		uintptr_t top = KEY( priq_peek( q ) );
+
+		for( unsigned j = 0; j < burst; ++j )
+			priq_enqueue( q, ELEM( top - 1 - rnd( &seed ) % 1024 ) );
+		for( unsigned j = 0; j < burst; ++j )
+			priq_dequeue( q );
+
+		done += burst;
+	}
+	t = now( ) - t;
+
+	priq_destroy( q, NULL );
+	return t * 1e9 / ( 2 * done );
+}
+
+int main( int argc, char** argv )
+{
+	uint64_t n = ( argc > 1 ) ? strtoull( argv[1], NULL, 10 ) : 100000;
+	uint64_t ops = ( argc > 2 ) ? strtoull( argv[2], NULL, 10 ) : 2000000;
+	unsigned buffers[] = { 0, 16, 32, 64 };
+
+	printf( "queue size %lu, %lu operations, ns/op\n", (unsigned long)n, (unsigned long)ops );
+	printf( "%8s %10s %10s\n", "buffer", "hold", "lifo" );
+
+	for( size_t i = 0; i < sizeof( buffers ) / sizeof( *buffers ); ++i )
+		printf( "%8u %10.1f %10.1f\n", buffers[i],
+			hold( buffers[i], n, ops ), lifo( buffers[i], n, ops ) );
+
+	return 0;
+}
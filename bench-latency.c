@@ -0,0 +1,250 @@
+/**
+ * Per operation latency of the skew and the leftist heap backend.
+ *
+ * hold:   the hold model, dequeue the top and enqueue it again with a
+ *         random increment, every enqueue and dequeue timed
+ * sorted: ascending keys enqueued, then all dequeued
+ * merge:  small queues merged into a big one, every merge timed
+ *
+ * alloc:  malloc of node sized blocks, as many as sorted enqueues. Only
+ *         sorted allocates a node per timed operation (hold and merge
+ *         reuse released nodes), compare its tail with this one.
+ *
+ * Every workload runs once untimed to warm up caches and the allocator,
+ * then several times. Reports the mean and the p50, p99, p99.9, p99.99
+ * and max latency, each the best over the runs, which drops most of the
+ * interference from other processes and page faults. Timer interrupts
+ * hit every run, with millions of operations they still show up in
+ * p99.99 and max. "max cmp" is the most comparisons of one operation,
+ * the noise free measure of the worst case.
+ * Usage: bench-latency [queue size] [operations] [runs]
+ */
+
+/* ---- System Header ------------------------------------------------------------ */
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ---- DOT Header --------------------------------------------------------------- */
+#include "priq.h"
+
+/* ---- Help funcs & macros ------------------------------------------------------ */
+#define perr(format, ...)  fprintf(stderr, "ERROR " format "\n", ## __VA_ARGS__)
+#define KEY(c) ((uintptr_t)(c))
+#define ELEM(k) ((void*)(uintptr_t)(k))
+
+static void* smalloc( size_t s )
+{
+	void * res = malloc( s );
+	if ( !res )
+	{
+		perr( "smalloc: Out of Memory. Requested size: %zd", s );
+		abort();
+	}
+	return res;
+}
+
+static inline uint64_t now_ns( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline uint64_t rnd( uint64_t* s )
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+static int u64_cmp( const void* p1, const void* p2 )
+{
+	uint64_t a = *(const uint64_t*)p1;
+	uint64_t b = *(const uint64_t*)p2;
+
+	return ( a > b ) - ( a < b );
+}
+
+/* ---- Benchmark ---------------------------------------------------------------- */
+
+// comparisons of the running operation, the most of any operation
+static uint64_t ncmp;
+static uint64_t maxcmp;
+
+int key_cmp( void* e1, void* e2 )
+{
+	ncmp++;
+	return ( ( KEY( e1 ) >= KEY( e2 ) ) - ( KEY( e2 ) >= KEY( e1 ) ) );
+}
+
+static uint64_t* lat;
+static uint64_t nlat;
+
+// mean, p50, p99, p99.9, p99.99 and max
+#define STATS 6
+static const double pct[STATS - 2] = { 0.5, 0.99, 0.999, 0.9999 };
+
+#define TIMED( op ) do { \
+		ncmp = 0; \
+		uint64_t t0_ = now_ns( ); \
+		op; \
+		lat[nlat++] = now_ns( ) - t0_; \
+		if( ncmp > maxcmp ) \
+			maxcmp = ncmp; \
+	} while( 0 )
+
+static void hold( Pribackend b, uint64_t n, uint64_t ops )
+{
+	uint64_t seed = 88172645463325252ULL;
+	Priq q = priq_create_backend( key_cmp, b );
+
+	for( uint64_t i = 0; i < n; ++i )
+		priq_enqueue( q, ELEM( 1 + rnd( &seed ) % ( 1ULL << 32 ) ) );
+
+	for( uint64_t i = 0; i < ops / 2; ++i )
+	{
+		uintptr_t k;
+		TIMED( k = KEY( priq_dequeue( q ) ) );
+		TIMED( priq_enqueue( q, ELEM( k + 1 + rnd( &seed ) % ( 1ULL << 20 ) ) ) );
+	}
+
+	priq_destroy( q, NULL );
+}
+
+static void sorted( Pribackend b, uint64_t n, uint64_t ops )
+{
+	Priq q = priq_create_backend( key_cmp, b );
+	uint64_t m = ( ops / 2 < n ) ? ops / 2 : n;
+
+	for( uint64_t i = 1; i <= m; ++i )
+		TIMED( priq_enqueue( q, ELEM( i ) ) );
+	for( uint64_t i = 1; i <= m; ++i )
+		TIMED( priq_dequeue( q ) );
+
+	priq_destroy( q, NULL );
+}
+
+static void merge( Pribackend b, uint64_t n, uint64_t ops )
+{
+	uint64_t seed = 88172645463325252ULL;
+	Priq q = priq_create_backend( key_cmp, b );
+
+	for( uint64_t i = 0; i < n; ++i )
+		priq_enqueue( q, ELEM( 1 + rnd( &seed ) % ( 1ULL << 32 ) ) );
+
+	for( uint64_t i = 0; i < ops / 64; ++i )
+	{
+		Priq s = priq_create_backend( key_cmp, b );
+		for( int j = 0; j < 32; ++j )
+			priq_enqueue( s, ELEM( 1 + rnd( &seed ) % ( 1ULL << 32 ) ) );
+
+		TIMED( q = priq_merge( q, s ) );
+
+		for( int j = 0; j < 32; ++j )
+			priq_dequeue( q );
+	}
+
+	priq_destroy( q, NULL );
+}
+
+static void alloc( Pribackend b, uint64_t n, uint64_t ops )
+{
+	uint64_t m = ( ops / 2 < n ) ? ops / 2 : n;
+	Heap** nodes = smalloc( m * sizeof( *nodes ) );
+
+	( void )b;
+	for( uint64_t i = 0; i < m; ++i )
+		TIMED( nodes[i] = smalloc( sizeof( Heap ) ); nodes[i]->count = 1 );
+	for( uint64_t i = 0; i < m; ++i )
+		free( nodes[i] );
+
+	free( nodes );
+}
+
+/**
+ * Keeps the best of every statistic of this run in best.
+ */
+static void measure( double* best, bool first )
+{
+	double stat[STATS];
+	uint64_t sum = 0;
+
+	qsort( lat, nlat, sizeof( *lat ), u64_cmp );
+	for( uint64_t i = 0; i < nlat; ++i )
+		sum += lat[i];
+
+	stat[0] = (double)sum / nlat;
+	for( int i = 0; i < STATS - 2; ++i )
+		stat[i + 1] = lat[(uint64_t)( ( nlat - 1 ) * pct[i] )];
+	stat[STATS - 1] = lat[nlat - 1];
+
+	for( int i = 0; i < STATS; ++i )
+		if( first || stat[i] < best[i] )
+			best[i] = stat[i];
+}
+
+static void report( const char* workload, const char* backend, const double* best )
+{
+	printf( "%-8s %-8s %10lu %8.1f %8.0f %8.0f %8.0f %8.0f %10.0f %8lu\n", workload, backend,
+		(unsigned long)nlat, best[0], best[1], best[2], best[3], best[4], best[5],
+		(unsigned long)maxcmp );
+}
+
+int main( int argc, char** argv )
+{
+	uint64_t n = ( argc > 1 ) ? strtoull( argv[1], NULL, 10 ) : 100000;
+	uint64_t ops = ( argc > 2 ) ? strtoull( argv[2], NULL, 10 ) : 2000000;
+	int runs = ( argc > 3 ) ? atoi( argv[3] ) : 5;
+
+	struct { const char* name; void ( *run )( Pribackend, uint64_t, uint64_t ); } workloads[] =
+	{
+		{ "hold", hold },
+		{ "sorted", sorted },
+		{ "merge", merge },
+		{ "alloc", alloc },
+	};
+	struct { const char* name; Pribackend b; } backends[] =
+	{
+		{ "skew", PRIQ_BACKEND_SKEW },
+		{ "leftist", PRIQ_BACKEND_LEFTIST },
+	};
+
+	if( ops < 64 || runs < 1 ) {
+		perr( "at least 64 operations and one run" ); return EXIT_FAILURE; }
+	lat = smalloc( ops * sizeof( *lat ) );
+	memset( lat, 0, ops * sizeof( *lat ) );
+
+	printf( "queue size %lu, %lu operations, best of %d runs, latency in ns\n",
+		(unsigned long)n, (unsigned long)ops, runs );
+	printf( "%-8s %-8s %10s %8s %8s %8s %8s %8s %10s %8s\n", "workload", "backend", "ops", "mean",
+		"p50", "p99", "p99.9", "p99.99", "max", "max cmp" );
+
+	for( size_t w = 0; w < sizeof( workloads ) / sizeof( *workloads ); ++w )
+		for( size_t b = 0; b < sizeof( backends ) / sizeof( *backends ); ++b )
+		{
+			double best[STATS];
+			maxcmp = 0;
+
+			// the first run only warms up
+			for( int r = 0; r <= runs; ++r )
+			{
+				nlat = 0;
+				workloads[w].run( backends[b].b, n, ops );
+				if( r )
+					measure( best, r == 1 );
+			}
+			report( workloads[w].name, workloads[w].run == alloc ? "-" : backends[b].name, best );
+
+			if( workloads[w].run == alloc )
+				break;
+		}
+
+	free( lat );
+	return 0;
+}
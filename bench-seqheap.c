@@ -0,0 +1,141 @@
+/**
+ * Sequence heap vs skew heap benchmark.
+ *
+ * Enqueues n random keys, then dequeues them all. Reports ns/op and
+ * cache misses per op (from perf events, n/a if not permitted).
+ * Keys are stored in the element pointers, so the comparator itself
+ * touches no memory.
+ * Usage: bench-seqheap [n ...]     (default 10^6 10^7, try 100000000)
+ */
+
+/* ---- System Header ------------------------------------------------------------ */
+#define _GNU_SOURCE
+#include <time.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/* ---- DOT Header --------------------------------------------------------------- */
+#include "priq.h"
+
+/* ---- Help funcs & macros ------------------------------------------------------ */
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// last level cache misses of this thread, -1 if not available
+static int miss_open( void )
+{
+	struct perf_event_attr pe;
+	memset( &pe, 0, sizeof( pe ) );
+	pe.type = PERF_TYPE_HARDWARE;
+	pe.size = sizeof( pe );
+	pe.config = PERF_COUNT_HW_CACHE_MISSES;
+	pe.disabled = 1;
+	pe.exclude_kernel = 1;
+	pe.exclude_hv = 1;
+
+	return syscall( __NR_perf_event_open, &pe, 0, -1, -1, 0 );
+}
+
+static void miss_start( int fd )
+{
+	if( fd < 0 )
+		return;
+	ioctl( fd, PERF_EVENT_IOC_RESET, 0 );
+	ioctl( fd, PERF_EVENT_IOC_ENABLE, 0 );
+}
+
+static int64_t miss_stop( int fd )
+{
+	int64_t res = -1;
+	if( fd < 0 )
+		return -1;
+	ioctl( fd, PERF_EVENT_IOC_DISABLE, 0 );
+	if( read( fd, &res, sizeof( res ) ) != sizeof( res ) )
+		return -1;
+	return res;
+}
+
+static inline uint64_t rnd( uint64_t* s )
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+/* ---- Benchmark ---------------------------------------------------------------- */
+
+int key_cmp( void* e1, void* e2 )
+{
+	uintptr_t k1 = (uintptr_t)e1;
+	uintptr_t k2 = (uintptr_t)e2;
+
+	return ( ( k1 >= k2 ) - ( k2 >= k1 ) );
+}
+
+static void report( const char* name, const char* phase, uint64_t n, double t, int64_t miss )
+{
+	printf( "%-9s %-8s %11lu %10.1f ", name, phase, (unsigned long)n, t * 1e9 / n );
+	if( miss < 0 )
+		printf( "%12s\n", "n/a" );
+	else
+		printf( "%12.2f\n", (double)miss / n );
+}
+
+static void bench( const char* name, Pribackend b, uint64_t n, int fd )
+{
+	Priq q = priq_create_backend( key_cmp, b );
+	uint64_t seed = 88172645463325252ULL;
+
+	miss_start( fd );
+	double t = now( );
+	for( uint64_t i = 0; i < n; ++i )
+		priq_enqueue( q, (void*)(uintptr_t)( rnd( &seed ) | 1 ) );
+	t = now( ) - t;
+	report( name, "enqueue", n, t, miss_stop( fd ) );
+
+	uintptr_t last = 0;
+	miss_start( fd );
+	t = now( );
+	for( uint64_t i = 0; i < n; ++i )
+	{
+		uintptr_t k = (uintptr_t)priq_dequeue( q );
+		if( k < last )
+			fprintf( stderr, "ERROR %s: wrong order\n", name );
+		last = k;
+	}
+	t = now( ) - t;
+	report( name, "dequeue", n, t, miss_stop( fd ) );
+
+	priq_destroy( q, NULL );
+}
+
+int main( int argc, char** argv )
+{
+	uint64_t def[] = { 1000000, 10000000 };
+	int fd = miss_open( );
+
+	printf( "%-9s %-8s %11s %10s %12s\n", "backend", "phase", "n", "ns/op", "misses/op" );
+
+	for( int i = 1; i < ( argc > 1 ? argc : 3 ); ++i )
+	{
+		uint64_t n = ( argc > 1 ) ? strtoull( argv[i], NULL, 10 ) : def[i - 1];
+		bench( "skew", PRIQ_BACKEND_SKEW, n, fd );
+		bench( "sequence", PRIQ_BACKEND_SEQUENCE, n, fd );
+	}
+
+	if( fd >= 0 )
+		close( fd );
+
+	return 0;
+}
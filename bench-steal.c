@@ -0,0 +1,132 @@
+/**
+ * Work stealing scheduler benchmark.
+ *
+ * Runs an uneven task DAG (fibonacci shaped, random task weights, all work
+ * seeded on worker 0) with 1..N workers and reports the scaling.
+ * Usage: bench-steal [max workers] [depth]
+ */
+
+/* ---- System Header ------------------------------------------------------------ */
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* ---- DOT Header --------------------------------------------------------------- */
+#include "priq.h"
+#include "priq_steal.h"
+
+/* ---- Help funcs & macros ------------------------------------------------------ */
+#define BENCH_SPIN 2000
+
+// task = depth in the low 8 bit, a seed for the weight above
+#define TASK(depth, seed) ((void*)(((uintptr_t)(seed) << 8) | (depth)))
+#define TASK_DEPTH(t) ((uintptr_t)(t) & 0xff)
+#define TASK_SEED(t) ((uintptr_t)(t) >> 8)
+
+static uint64_t sink = 0;
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static inline uintptr_t mix( uintptr_t x )
+{
+	x ^= x >> 17;
+	x *= 0xed5ad4bbU;
+	x ^= x >> 11;
+	return x & 0xffffff;
+}
+
+/* ---- Benchmark ---------------------------------------------------------------- */
+
+// deeper tasks first, they spawn the most work
+int task_cmp( void* e1, void* e2 )
+{
+	uintptr_t d1 = TASK_DEPTH( e1 );
+	uintptr_t d2 = TASK_DEPTH( e2 );
+
+	return ( ( d2 >= d1 ) - ( d1 >= d2 ) );
+}
+
+void task_run( PriqWs ws, unsigned worker, void* c )
+{
+	uintptr_t depth = TASK_DEPTH( c );
+	uintptr_t seed = TASK_SEED( c );
+	uint64_t spin = BENCH_SPIN * ( 1 + seed % 8 );
+	uint64_t x = seed;
+
+	for( uint64_t i = 0; i < spin; ++i )
+		x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+	__atomic_add_fetch( &sink, x & 1, __ATOMIC_RELAXED );
+
+	if( depth > 1 )
+		priq_ws_submit( ws, worker, TASK( depth - 1, mix( seed * 2 + 1 ) ) );
+	if( depth > 2 )
+		priq_ws_submit( ws, worker, TASK( depth - 2, mix( seed * 2 + 2 ) ) );
+}
+
+// number of tasks in the DAG of the given depth
+static uint64_t dag_size( uintptr_t depth )
+{
+	uint64_t t1 = 1, t2 = 2;
+
+	if( depth < 2 )
+		return depth;
+
+	for( uintptr_t i = 3; i <= depth; ++i )
+	{
+		uint64_t t = 1 + t1 + t2;
+		t1 = t2;
+		t2 = t;
+	}
+	return t2;
+}
+
+static double run( unsigned workers, uintptr_t depth, uint64_t* steals )
+{
+	PriqWs ws = priq_ws_create( workers, task_cmp, task_run );
+
+	priq_ws_submit( ws, 0, TASK( depth, 1 ) );
+
+	double t = now( );
+	priq_ws_run( ws );
+	t = now( ) - t;
+
+	*steals = priq_ws_steals( ws );
+	priq_ws_destroy( ws, NULL );
+
+	return t;
+}
+
+int main( int argc, char** argv )
+{
+	long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+	unsigned max = ( argc > 1 ) ? (unsigned)atoi( argv[1] ) : (unsigned)( cpus > 0 ? cpus : 1 );
+	uintptr_t depth = ( argc > 2 ) ? (uintptr_t)atoi( argv[2] ) : 24;
+	uint64_t tasks = dag_size( depth );
+	double base = 0;
+
+	printf( "uneven fibonacci DAG, depth %lu, %lu tasks, %ld online cpus\n",
+		(unsigned long)depth, (unsigned long)tasks, cpus );
+	printf( "%8s %12s %12s %10s %12s\n", "workers", "seconds", "tasks/s", "speedup", "steals" );
+
+	for( unsigned w = 1; w <= max; w = ( w * 2 > max && w != max ) ? max : w * 2 )
+	{
+		uint64_t steals = 0;
+		double t = run( w, depth, &steals );
+
+		if( w == 1 )
+			base = t;
+
+		printf( "%8u %12.3f %12.0f %10.2f %12lu\n", w, t, tasks / t, base / t,
+			(unsigned long)steals );
+	}
+
+	return 0;
+}
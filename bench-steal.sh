@@ -0,0 +1,11 @@
+#!/bin/bash
+
+TARGET="bench-steal"
+SRC="bench-steal.c"
+
+## FLAGS
+CFLAGS="-O2 -std=c99 -pipe -Winline -Wall -Wextra -Werror -Wno-unused -pthread"
+LDLIBS="libpriq.a"
+CC="gcc"
+
+make && $CC $CFLAGS -o $TARGET $SRC $LDLIBS && ./$TARGET "$@"
@@ -0,0 +1,365 @@
+/**
+ * Replays a priq operation trace (see priq_trace.h) against a backend
+ * and reports ns/op and comparator calls. dequeue_max records are
+ * replayed on the interval heap only, the other backends skip them and
+ * report them as unsupported.
+ *
+ * Usage: priq-replay [-b backend] [-r repeats] trace
+ */
+
+/* ---- System Header ------------------------------------------------------------ */
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* ---- DOT Header --------------------------------------------------------------- */
+#include "priq.h"
+#include "priq_trace.h"
+
+/* ---- Help funcs & macros ------------------------------------------------------ */
+#define perr(format, ...)  fprintf(stderr, "ERROR " format "\n", ## __VA_ARGS__)
+
+static void* smalloc( size_t s )
+{
+	void * res = malloc( s );
+	if ( !res )
+	{
+		perr( "smalloc: Out of Memory. Requested size: %zd", s );
+		abort();
+	}
+	return res;
+}
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* ---- Backends ----------------------------------------------------------------- */
+
+struct backend
+{
+	const char* name;
+	Priq ( *create )( Pricmp cmp );
+	// has priq_dequeue_max
+	int max;
+};
+
+static Priq create_sequence( Pricmp cmp )
+{
+	return priq_create_backend( cmp, PRIQ_BACKEND_SEQUENCE );
+}
+
+static Priq create_interval( Pricmp cmp )
+{
+	return priq_create_backend( cmp, PRIQ_BACKEND_INTERVAL );
+}
+
+static Priq create_leftist( Pricmp cmp )
+{
+	return priq_create_backend( cmp, PRIQ_BACKEND_LEFTIST );
+}
+
+static const struct backend backends[] =
+{
+	{ "skew", priq_create, 0 },
+	{ "sequence", create_sequence, 0 },
+	{ "interval", create_interval, 1 },
+	{ "leftist", create_leftist, 0 },
+};
+
+#define NBACKENDS ( sizeof( backends ) / sizeof( *backends ) )
+
+/* ---- Replay ------------------------------------------------------------------- */
+
+// replayed element, ordered by the recorded fingerprint
+struct elem
+{
+	uint64_t key;
+	uint64_t id;
+};
+
+static uint64_t ncmp = 0;
+
+int elem_cmp( void* e1, void* e2 )
+{
+	const struct elem* i1 = e1;
+	const struct elem* i2 = e2;
+
+	ncmp++;
+	return ( ( i1->key >= i2->key ) - ( i2->key >= i1->key ) );
+}
+
+static int rec_cmp( const void* r1, const void* r2 )
+{
+	uint64_t s1 = PRIQ_TRACE_SEQ( (const PriqTrace*)r1 );
+	uint64_t s2 = PRIQ_TRACE_SEQ( (const PriqTrace*)r2 );
+
+	return ( s1 > s2 ) - ( s1 < s2 );
+}
+
+// traced queue id -> replayed queue, open addressing
+struct slot
+{
+	uint64_t id;
+	Priq q;
+};
+
+static struct slot* slots = NULL;
+static uint64_t nslots = 0;
+
+static struct slot* lookup( uint64_t id )
+{
+	uint64_t i = ( id * 0x9e3779b97f4a7c15ULL ) & ( nslots - 1 );
+
+	while( slots[i].id && slots[i].id != id )
+		i = ( i + 1 ) & ( nslots - 1 );
+
+	return slots + i;
+}
+
+static void forget( uint64_t id )
+{
+	struct slot* s = lookup( id );
+	if( !s->id )
+		return;
+
+	// backward shift delete
+	uint64_t i = s - slots;
+	uint64_t j = i;
+	slots[i].id = 0;
+	for( ;; )
+	{
+		j = ( j + 1 ) & ( nslots - 1 );
+		if( !slots[j].id )
+			break;
+		uint64_t k = ( slots[j].id * 0x9e3779b97f4a7c15ULL ) & ( nslots - 1 );
+		if( ( i <= j ) ? ( i < k && k <= j ) : ( i < k || k <= j ) )
+			continue;
+		slots[i] = slots[j];
+		slots[j].id = 0;
+		i = j;
+	}
+}
+
+struct result
+{
+	uint64_t ops[PRIQ_OP_DEQUEUE_MAX + 1];
+	uint64_t mismatch;
+	uint64_t missing;
+	uint64_t unsupported;
+	double seconds;
+};
+
+static void replay( const PriqTrace* rec, uint64_t n, const struct backend* b,
+	struct elem* elems, struct result* res )
+{
+	memset( res, 0, sizeof( *res ) );
+	memset( slots, 0, nslots * sizeof( *slots ) );
+
+	double t = now( );
+
+	for( uint64_t i = 0; i < n; ++i )
+	{
+		const PriqTrace* r = rec + i;
+		unsigned op = PRIQ_TRACE_OP( r );
+		struct slot* s = lookup( r->queue );
+
+		if( op == PRIQ_OP_CREATE )
+		{
+			s->id = r->queue;
+			s->q = b->create( elem_cmp );
+			res->ops[op]++;
+			continue;
+		}
+
+		// traced before the trace started or corrupted
+		if( !s->id || op > PRIQ_OP_DEQUEUE_MAX )
+		{
+			res->missing++;
+			continue;
+		}
+
+		// only the interval heap is double ended
+		if( op == PRIQ_OP_DEQUEUE_MAX && !b->max )
+		{
+			res->unsupported++;
+			continue;
+		}
+
+		res->ops[op]++;
+
+		switch( op )
+		{
+		case PRIQ_OP_DESTROY:
+			priq_destroy( s->q, NULL );
+			forget( r->queue );
+			break;
+
+		case PRIQ_OP_ENQUEUE:
+			elems[i].key = r->key;
+			elems[i].id = r->arg;
+			priq_enqueue( s->q, elems + i );
+			break;
+
+		case PRIQ_OP_DEQUEUE:
+		case PRIQ_OP_DEQUEUE_MAX:
+		{
+			struct elem* e = ( op == PRIQ_OP_DEQUEUE )
+				? priq_dequeue( s->q ) : priq_dequeue_max( s->q );
+			if( ( e ? e->key : 0 ) != r->key || !e != !r->arg )
+				res->mismatch++;
+			break;
+		}
+
+		case PRIQ_OP_MERGE:
+		case PRIQ_OP_SPLIT:
+		{
+			struct slot* o = lookup( r->arg );
+			if( !o->id )
+			{
+				res->missing++;
+				break;
+			}
+			if( op == PRIQ_OP_SPLIT )
+			{
+				priq_split( s->q, o->q );
+				break;
+			}
+			priq_merge( s->q, o->q );
+			forget( r->arg );
+			break;
+		}
+
+		case PRIQ_OP_CLONE:
+		{
+			Priq c = priq_clone( s->q );
+			if( !c )
+			{
+				res->missing++;
+				break;
+			}
+			struct slot* o = lookup( r->arg );
+			o->id = r->arg;
+			o->q = c;
+			break;
+		}
+		}
+	}
+
+	res->seconds = now( ) - t;
+
+	// queues still alive at the end of the trace
+	for( uint64_t i = 0; i < nslots; ++i )
+		if( slots[i].id )
+			priq_destroy( slots[i].q, NULL );
+}
+
+static void usage( void )
+{
+	fprintf( stderr, "usage: priq-replay [-b backend] [-r repeats] trace\nbackends:" );
+	for( size_t i = 0; i < NBACKENDS; ++i )
+		fprintf( stderr, " %s", backends[i].name );
+	fprintf( stderr, " all\n" );
+	exit( EXIT_FAILURE );
+}
+
+int main( int argc, char** argv )
+{
+	const char* which = "all";
+	unsigned repeats = 3;
+	int opt;
+
+	while( ( opt = getopt( argc, argv, "b:r:" ) ) != -1 )
+	{
+		if( opt == 'b' )
+			which = optarg;
+		else if( opt == 'r' )
+			repeats = (unsigned)atoi( optarg );
+		else
+			usage( );
+	}
+	if( optind != argc - 1 || !repeats )
+		usage( );
+
+	// a libpriq built with PRIQ_TRACE must not overwrite the input
+	setenv( "PRIQ_TRACE_FILE", "/dev/null", 1 );
+
+	FILE* f = fopen( argv[optind], "rb" );
+	if( !f ) {
+		perr( "can't open %s", argv[optind] ); return EXIT_FAILURE; }
+
+	fseek( f, 0, SEEK_END );
+	uint64_t n = ftell( f ) / sizeof( PriqTrace );
+	fseek( f, 0, SEEK_SET );
+
+	PriqTrace* rec = smalloc( ( n ? n : 1 ) * sizeof( *rec ) );
+	if( fread( rec, sizeof( *rec ), n, f ) != n ) {
+		perr( "can't read %s", argv[optind] ); return EXIT_FAILURE; }
+	fclose( f );
+
+	// thread buffers are written out of order
+	qsort( rec, n, sizeof( *rec ), rec_cmp );
+
+	uint64_t queues = 0;
+	for( uint64_t i = 0; i < n; ++i )
+		queues += ( PRIQ_TRACE_OP( rec + i ) == PRIQ_OP_CREATE
+		         || PRIQ_TRACE_OP( rec + i ) == PRIQ_OP_CLONE );
+	for( nslots = 16; nslots < 2 * queues; nslots *= 2 )
+		;
+	slots = smalloc( nslots * sizeof( *slots ) );
+
+	struct elem* elems = smalloc( ( n ? n : 1 ) * sizeof( *elems ) );
+
+	printf( "%lu records\n", (unsigned long)n );
+	printf( "%-10s %10s %10s %10s %10s %10s %12s %10s %10s\n", "backend", "ns/op",
+		"cmp/op", "enqueue", "dequeue", "merge", "split", "clone", "mismatch" );
+
+	int found = 0;
+	for( size_t b = 0; b < NBACKENDS; ++b )
+	{
+		if( strcmp( which, "all" ) && strcmp( which, backends[b].name ) )
+			continue;
+		found = 1;
+
+		struct result res, best;
+		for( unsigned k = 0; k < repeats; ++k )
+		{
+			ncmp = 0;
+			replay( rec, n, backends + b, elems, &res );
+			if( !k || res.seconds < best.seconds )
+				best = res;
+		}
+
+		uint64_t ops = n - best.missing - best.unsupported;
+		printf( "%-10s %10.1f %10.2f %10lu %10lu %10lu %12lu %10lu %10lu\n", backends[b].name,
+			ops ? best.seconds * 1e9 / ops : 0.0, ops ? (double)ncmp / ops : 0.0,
+			(unsigned long)best.ops[PRIQ_OP_ENQUEUE],
+			(unsigned long)( best.ops[PRIQ_OP_DEQUEUE] + best.ops[PRIQ_OP_DEQUEUE_MAX] ),
+			(unsigned long)best.ops[PRIQ_OP_MERGE], (unsigned long)best.ops[PRIQ_OP_SPLIT],
+			(unsigned long)best.ops[PRIQ_OP_CLONE],
+			(unsigned long)best.mismatch );
+
+		if( best.missing )
+			printf( "%-10s %lu records without a created queue skipped\n", "",
+				(unsigned long)best.missing );
+		if( best.unsupported )
+			printf( "%-10s %lu dequeue_max records unsupported, skipped\n", "",
+				(unsigned long)best.unsupported );
+	}
+
+	if( !found )
+		usage( );
+
+	free( elems );
+	free( slots );
+	free( rec );
+
+	return 0;
+}
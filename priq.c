@@ -6,8 +6,16 @@
 ////////////////////////////////////////////////////////////////////////////////
 // HEADER
 
+#ifdef PRIQ_TRACE
+	#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include "priq.h"
+#include "priq_trace.h"
+#include "priq_seq.h"
+#include "priq_ival.h"
 #include <stdlib.h>
+#include <string.h>
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -27,8 +35,58 @@
 			__FILE__ "   Line: %d", __LINE__); \
 			exit(EXIT_FAILURE_ASSERT); \
 		}
+
+	// Full invariant check at every INVARIANT_SAMPLE-th check point of a
+	// thread, 0 for never. The cheap local checks run at every point.
+	#ifndef INVARIANT_SAMPLE
+		#define INVARIANT_SAMPLE 1024
+	#endif
+
+	static __thread uint64_t _priq_inv_points = 0;
+	static bool _priq_local_inv(Priq q);
+
+	#define _priq_inv_due() (INVARIANT_SAMPLE && \
+		++_priq_inv_points % (INVARIANT_SAMPLE ? INVARIANT_SAMPLE : 1) == 0)
+	#define INVARIANT(q, ...) \
+		ASSERT(_priq_local_inv(q) && (!_priq_inv_due() || priq_check_invariant(q)), \
+			__VA_ARGS__)
 #else
 	#define ASSERT(x, ...)
+	#define INVARIANT(q, ...)
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TRACING
+#ifdef PRIQ_TRACE
+	#include <fcntl.h>
+	#include <pthread.h>
+	#include <unistd.h>
+
+	#define PRIQ_TRACE_BUFFER 4096
+
+	// Per thread record buffer
+	struct _PriqTraceBuffer
+	{
+		PriqTrace rec[PRIQ_TRACE_BUFFER];
+		unsigned n;
+		bool active;
+	};
+
+	static __thread struct _PriqTraceBuffer _priq_trace_buf;
+	static uint64_t _priq_trace_seq = 0;
+	static int _priq_trace_fd = -1;
+	static Prikey _priq_trace_keyf = NULL;
+	static pthread_key_t _priq_trace_tkey;
+	static pthread_once_t _priq_trace_init_once = PTHREAD_ONCE_INIT;
+	static pthread_once_t _priq_trace_open_once = PTHREAD_ONCE_INIT;
+
+	static void _priq_trace(unsigned op, const void* q, uint64_t arg, uint64_t key);
+
+	#define TRACE(op, q, arg, key) _priq_trace(op, q, arg, key)
+	#define TRACE_KEY(c) (_priq_trace_keyf ? _priq_trace_keyf(c) : (uint64_t)(uintptr_t)(c))
+#else
+	#define TRACE(op, q, arg, key)
 #endif
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -36,15 +94,40 @@
 // FUNCTIONS INTERN
 
 static inline Heap* _priq_create_heap(cp c);
-static Heap* _priq_heap_merge(Heap* h1, Heap* h2, Pricmp cmp);
+static inline Heap* _priq_take_heap(Priq q, cp c);
+static inline void _priq_give_heap(Priq q, Heap* h);
+static void _priq_spare_destroy(Priq q);
+static inline Heap* _priq_own_heap(Priq q, Heap* h);
+static inline Heap* _priq_heap_merge(Priq q, Heap* h1, Heap* h2);
+static Heap* _priq_skew_merge(Priq q, Heap* h1, Heap* h2);
+static Heap* _priq_leftist_merge(Priq q, Heap* h1, Heap* h2);
+static bool _priq_node_inv(Heap* h, Pricmp cmp);
+static bool _priq_rank_inv(Heap* h, bool deep);
 static bool _priq_heap_inv(Heap* h, Pricmp cmp);
 static uint64_t _priq_count_contend(Heap* h);
-static void _priq_heap_destroy(Heap* h, Freefunc ff);
+static void _priq_heap_destroy(Heap* h, Freefunc ff, bool release);
+static cp _priq_top(Priq q);
+static cp _priq_pop(Priq q);
+static void _priq_ibuf_flush(Priq q);
+static void _priq_drop_dead(Priq q);
+static void _priq_drop_dead_max(Priq q);
+static void _priq_move_dead(Priq q, Priq out, uint64_t moved);
+static void _priq_split_nodes(Priq q, Priq out, uint64_t k);
 
 // -----------------------------------------------------------------------------
 
 #define _priq_is_empty_heap(h) ((h)==NULL)
 #define _priq_heap_contend(h) (h->contend)
+#define _priq_heap_count(h) (_priq_is_empty_heap(h) ? 0 : (h)->count)
+#define _priq_is_seq(q) ((q)->backend == PRIQ_BACKEND_SEQUENCE)
+#define _priq_is_ival(q) ((q)->backend == PRIQ_BACKEND_INTERVAL)
+#define _priq_is_leftist(q) ((q)->backend == PRIQ_BACKEND_LEFTIST)
+// Backends made of Heap nodes
+#define _priq_is_tree(q) ((q)->backend == PRIQ_BACKEND_SKEW || _priq_is_leftist(q))
+#define _priq_heap_rank(h) (_priq_is_empty_heap(h) ? 0 : (h)->rank)
+#define _priq_ibuf_min(q) ((q)->ibuf[(q)->nibuf - 1])
+#define _priq_ibuf_first(q) ((q)->nibuf && \
+	(!(q)->top || (q)->cmp(_priq_ibuf_min(q), (q)->top->contend) <= 0))
 
 
 // -----------------------------------------------------------------------------
@@ -68,16 +151,120 @@ static inline Heap* _priq_create_heap(cp c)
 	res->right = NULL;
 	res->left = NULL;
 	res->contend = c;
+	res->count = 1;
+	res->refs = 1;
+	res->rank = 1;
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a new heap, takes a released node of the queue if there is one.
+ * Complexity always O(1)
+ */
+static inline Heap* _priq_take_heap(Priq q, cp c)
+{
+	Heap* res = q->spare;
+	if(!res)
+		return _priq_create_heap(c);
+
+	q->spare = res->right;
+	q->nspare--;
+
+	res->right = NULL;
+	res->left = NULL;
+	res->contend = c;
+	res->count = 1;
+	res->refs = 1;
+	res->rank = 1;
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Makes a node private to the queue before it is changed. A node shared
+ * with a clone is copied, the copy shares the children of the original.
+ * Queues that never met a clone don't look at refs at all.
+ * Complexity always O(1)
+ */
+static inline Heap* _priq_own_heap(Priq q, Heap* h)
+{
+	if(!q->shared || h->refs == 1)
+		return h;
+
+	Heap* res = _priq_take_heap(q, h->contend);
+	res->left = h->left;
+	res->right = h->right;
+	res->count = h->count;
+	res->rank = h->rank;
+
+	if(res->left)
+		res->left->refs++;
+	if(res->right)
+		res->right->refs++;
+	h->refs--;
+
 	return res;
 }
 
+// -----------------------------------------------------------------------------
+/**
+ * Releases a single node. It is kept for reuse unless the cache is full.
+ * Complexity always O(1)
+ */
+static inline void _priq_give_heap(Priq q, Heap* h)
+{
+	if(q->nspare >= PRIQ_NODE_CACHE)
+	{
+		free(h);
+		return;
+	}
+
+	h->right = q->spare;
+	q->spare = h;
+	q->nspare++;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Frees all cached nodes of a queue.
+ * Complexity O(PRIQ_NODE_CACHE)
+ */
+static void _priq_spare_destroy(Priq q)
+{
+	while(q->spare)
+	{
+		Heap* h = q->spare;
+		q->spare = h->right;
+		free(h);
+	}
+	q->nspare = 0;
+}
+
 // -----------------------------------------------------------------------------
 /**
  * Merges to heaps together. Will preserve the correct priority order.
+ * Nodes on the merge path that are shared with a clone are copied.
+ * The backend is picked once, the merge loops don't branch on it.
  * Complexity O(log n)
  */
-static Heap* _priq_heap_merge(Heap* h1, Heap* h2, Pricmp cmp)
+static inline Heap* _priq_heap_merge(Priq q, Heap* h1, Heap* h2)
 {
+	return _priq_is_leftist(q)
+		? _priq_leftist_merge(q, h1, h2)
+		: _priq_skew_merge(q, h1, h2);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Skew heap merge, walks down the left children and swaps the children
+ * of every node on the path.
+ * Complexity O(log n), amortized
+ */
+static Heap* _priq_skew_merge(Priq q, Heap* h1, Heap* h2)
+{
+	Pricmp cmp = q->cmp;
+
 	if(_priq_is_empty_heap(h1))
 		return h2;
 
@@ -85,29 +272,74 @@ static Heap* _priq_heap_merge(Heap* h1, Heap* h2, Pricmp cmp)
 		return h1;
 
 	if(cmp(h1->contend, h2->contend) > 0) // h1 > h2
-	{ 
-		// h1 now tmp var
-		h1 = _priq_heap_merge(h2->left, h1, cmp);
+	{
+		Heap* t = h1;
+		h1 = h2;
+		h2 = t;
+	}
+
+	// h1 <= h2
+	h1 = _priq_own_heap(q, h1);
+	h1->count += h2->count;
+
+	// h2 now tmp var
+	h2 = _priq_skew_merge(q, h1->left, h2);
+
+	// care for balance
+	h1->left = h1->right;
+	h1->right = h2;
 
-		// care for balance
-		h2->left = h2->right;
-		h2->right = h1;
+	ASSERT(_priq_node_inv(h1, cmp), "_priq_skew_merge: inv failed");
+	return h1;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Leftist heap merge, walks down the right spine and keeps the child
+ * with the lower rank on the right.
+ * Complexity O(log n)
+ */
+static Heap* _priq_leftist_merge(Priq q, Heap* h1, Heap* h2)
+{
+	Pricmp cmp = q->cmp;
 
-		ASSERT(_priq_heap_inv(h2, cmp), "_priq_heap_merge: inv failed");
+	if(_priq_is_empty_heap(h1))
 		return h2;
-	}
-	else   // h1 <= h2	
+
+	if(_priq_is_empty_heap(h2))
+		return h1;
+
+	if(cmp(h1->contend, h2->contend) > 0) // h1 > h2
 	{
-		// h2 now tmp var
-		h2 = _priq_heap_merge(h1->left, h2, cmp);
+		Heap* t = h1;
+		h1 = h2;
+		h2 = t;
+	}
 
-		// care for balance
-		h1->left = h1->right;
-		h1->right = h2;
+	// h1 <= h2
+	h1 = _priq_own_heap(q, h1);
+	h1->count += h2->count;
 
-		ASSERT(_priq_heap_inv(h1, cmp), "_priq_heap_merge: inv failed");
-		return h1;
+	// h2 now tmp var
+	h2 = _priq_leftist_merge(q, h1->right, h2);
+
+	if(_priq_heap_rank(h1->left) >= h2->rank)
+	{
+		h1->right = h2;
 	}
+	else
+	{
+		h1->right = h1->left;
+		h1->left = h2;
+	}
+	h1->rank = 1 + _priq_heap_rank(h1->right);
+
+	ASSERT(
+		_priq_node_inv(h1, cmp)
+		&&
+		_priq_rank_inv(h1, false),
+		"_priq_leftist_merge: inv failed");
+	return h1;
 }
 
 // -----------------------------------------------------------------------------
@@ -137,17 +369,35 @@ static uint64_t _priq_count_contend(Heap* h)
 
 // -----------------------------------------------------------------------------
 /**
- * Heap Invariant.
- * Complexity always O(n)
+ * Node Invariant, the node and its direct children only.
+ * Complexity always O(1)
  */
-static bool _priq_heap_inv(Heap* h, Pricmp cmp)
+static bool _priq_node_inv(Heap* h, Pricmp cmp)
 {
 	return _priq_is_empty_heap(h) 
 		||
 		(
+			h->refs >= 1
+		 	&&
+			h->count == 1 + _priq_heap_count(h->left) + _priq_heap_count(h->right)
+		 	&&
 			_priq_ge_or_eq(h->left, h->contend, cmp)
 		 	&&
 		  	_priq_ge_or_eq(h->right, h->contend, cmp)
+		);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Heap Invariant.
+ * Complexity always O(n)
+ */
+static bool _priq_heap_inv(Heap* h, Pricmp cmp)
+{
+	return _priq_is_empty_heap(h) 
+		||
+		(
+			_priq_node_inv(h, cmp)
 		 	&&
 		  	_priq_heap_inv(h->left, cmp)
 		 	&&
@@ -156,24 +406,52 @@ static bool _priq_heap_inv(Heap* h, Pricmp cmp)
 }
 
 
+// -----------------------------------------------------------------------------
+/**
+ * Leftist heap invariant: the rank is the length of the right spine and
+ * the left child never has the lower rank. Just the node unless deep.
+ * Complexity always O(1), O(n) if deep
+ */
+static bool _priq_rank_inv(Heap* h, bool deep)
+{
+	return _priq_is_empty_heap(h)
+		||
+		(
+			h->rank == 1 + _priq_heap_rank(h->right)
+			&&
+			_priq_heap_rank(h->left) >= _priq_heap_rank(h->right)
+			&&
+			(!deep || (_priq_rank_inv(h->left, true) && _priq_rank_inv(h->right, true)))
+		);
+}
+
+
 // -----------------------------------------------------------------------------
 /**
  * Destroys a heap, frees all memory and relives the contend with
  * a user defined free function. The contend will not be freed
- * if = NULL.
+ * if = NULL. Nodes still used by a clone lose one reference only,
+ * if release is false the nodes are not touched at all.
  * Complexity O(n)
  */
-static void _priq_heap_destroy(Heap* h, Freefunc ff)
+static void _priq_heap_destroy(Heap* h, Freefunc ff, bool release)
 {
 	if(! _priq_is_empty_heap(h))
 	{
-		_priq_heap_destroy(h->right, ff);
-		_priq_heap_destroy(h->left, ff);
+		bool freeme = release && --h->refs == 0;
+
+		// nothing to do below a shared node
+		if(!freeme && ff == NULL)
+			return;
+
+		_priq_heap_destroy(h->right, ff, freeme);
+		_priq_heap_destroy(h->left, ff, freeme);
 		
 		if(ff != NULL)
 			ff(h->contend);
 
-		free(h);
+		if(freeme)
+			free(h);
 	}
 }
 
@@ -197,10 +475,375 @@ static uint64_t _priq_heap_deepness(Heap* h)
 #endif
 
 
+// -----------------------------------------------------------------------------
+/**
+ * Returns the top element of a non empty queue, no matter if it is dead.
+ * Complexity always O(1), O(log n) for the sequence heap
+ */
+static cp _priq_top(Priq q)
+{
+	if(_priq_is_seq(q))
+		return _priq_seq_peek(q->impl, q->cmp);
+
+	if(_priq_is_ival(q))
+		return _priq_ival_min(q->impl);
+
+	if(_priq_ibuf_first(q))
+		return _priq_ibuf_min(q);
+
+	return _priq_heap_contend(q->top);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes the top element, no matter if it is dead.
+ * Complexity O(log n)
+ */
+static cp _priq_pop(Priq q)
+{
+	cp res;
+
+	if(_priq_is_seq(q))
+	{
+		res = _priq_seq_delete(q->impl, q->cmp);
+	}
+	else if(_priq_is_ival(q))
+	{
+		res = _priq_ival_delete_min(q->impl, q->cmp);
+	}
+	else if(_priq_ibuf_first(q))
+	{
+		res = q->ibuf[--q->nibuf];
+	}
+	else
+	{
+		Heap* delme = _priq_own_heap(q, q->top);
+		res = _priq_heap_contend(delme);
+
+		q->top = _priq_heap_merge(q, delme->right, delme->left);
+		_priq_give_heap(q, delme);
+	}
+	q->size--;
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Inserts an element into the insertion buffer, a full buffer is
+ * flushed first. The smallest element is kept at the end.
+ * Complexity O(PRIQ_IBUF_MAX)
+ */
+static void _priq_ibuf_insert(Priq q, cp c)
+{
+	if(q->nibuf == q->ibuf_cap)
+		_priq_ibuf_flush(q);
+
+	uint32_t i = q->nibuf++;
+	while(i > 0 && q->cmp(q->ibuf[i - 1], c) < 0)
+	{
+		q->ibuf[i] = q->ibuf[i - 1];
+		i--;
+	}
+	q->ibuf[i] = c;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Merges the insertion buffer into the heap as one batch. The sorted
+ * buffer is laid out as a complete binary tree, which is heap ordered.
+ * Complexity O(PRIQ_IBUF_MAX + log n)
+ */
+static void _priq_ibuf_flush(Priq q)
+{
+	Heap* nodes[PRIQ_IBUF_MAX];
+	uint32_t n = q->nibuf;
+
+	if(!n)
+		return;
+
+	// node i holds the i-th smallest, children first
+	for(uint32_t i = n; i-- > 0;)
+	{
+		Heap* h = _priq_take_heap(q, q->ibuf[n - 1 - i]);
+		h->left = (2 * i + 1 < n) ? nodes[2 * i + 1] : NULL;
+		h->right = (2 * i + 2 < n) ? nodes[2 * i + 2] : NULL;
+		h->count = 1 + _priq_heap_count(h->left) + _priq_heap_count(h->right);
+		// the right subtree is never deeper, so this is leftist too
+		h->rank = 1 + _priq_heap_rank(h->right);
+		nodes[i] = h;
+	}
+
+	q->nibuf = 0;
+	q->top = _priq_heap_merge(q, q->top, nodes[0]);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Tombstone mode: removes dead elements from the top.
+ * Complexity O(log n) per dead element
+ */
+static void _priq_drop_dead(Priq q)
+{
+	while(!priq_is_empty(q))
+	{
+		cp c = _priq_top(q);
+
+		if(!q->dead(c))
+			break;
+
+		_priq_pop(q);
+		if(q->deadfree)
+			q->deadfree(c);
+		if(q->ndead)
+			q->ndead--;
+	}
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Tombstone mode: removes dead elements from the bottom of an
+ * interval heap.
+ * Complexity O(log n) per dead element
+ */
+static void _priq_drop_dead_max(Priq q)
+{
+	while(!priq_is_empty(q))
+	{
+		cp c = _priq_ival_max(q->impl);
+
+		if(!q->dead(c))
+			break;
+
+		_priq_ival_delete_max(q->impl, q->cmp);
+		q->size--;
+		if(q->deadfree)
+			q->deadfree(c);
+		if(q->ndead)
+			q->ndead--;
+	}
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Tombstone mode: moves the share of dead elements of moved elements
+ * from q to out. Only an estimate, the dead ones are not known.
+ */
+static void _priq_move_dead(Priq q, Priq out, uint64_t moved)
+{
+	uint64_t n = priq_size(q) ? (uint64_t)((double)q->ndead * moved / priq_size(q)) : 0;
+
+	q->ndead -= n;
+	out->ndead += n;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves the k smallest elements of the tree of q into the tree of out one
+ * node by node, for priq_split on trees too deep to find a subtree of
+ * about half size. No node is allocated, counts are kept by the merges.
+ * Complexity O(k log n), amortized but worst case for the leftist heap
+ */
+static void _priq_split_nodes(Priq q, Priq out, uint64_t k)
+{
+	for(uint64_t i = 0; i < k; ++i)
+	{
+		Heap* h = _priq_own_heap(q, q->top);
+
+		q->top = _priq_heap_merge(q, h->right, h->left);
+
+		h->left = NULL;
+		h->right = NULL;
+		h->count = 1;
+		h->rank = 1;
+		out->top = _priq_heap_merge(out, out->top, h);
+	}
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * priq_remove_if helper: collects the kept nodes of a heap into keep and
+ * releases the others. Nodes shared with a clone are copied, a shared
+ * subtree loses the reference of this queue.
+ * Complexity O(n)
+ */
+static void _priq_heap_filter(Priq q, Heap* h, bool owned, Pripred pred,
+	Freefunc ff, Heap** keep, uint64_t* nkeep)
+{
+	if(_priq_is_empty_heap(h))
+		return;
+
+	if(owned && h->refs > 1)
+	{
+		h->refs--;
+		owned = false;
+	}
+
+	Heap* left = h->left;
+	Heap* right = h->right;
+	cp c = h->contend;
+
+	if(pred(c))
+	{
+		if(ff != NULL)
+			ff(c);
+		if(owned)
+			_priq_give_heap(q, h);
+	}
+	else
+	{
+		Heap* k = owned ? h : _priq_take_heap(q, c);
+		k->left = NULL;
+		k->right = NULL;
+		k->count = 1;
+		k->rank = 1;
+		keep[(*nkeep)++] = k;
+	}
+
+	_priq_heap_filter(q, left, owned, pred, ff, keep, nkeep);
+	_priq_heap_filter(q, right, owned, pred, ff, keep, nkeep);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Builds one heap out of n single nodes by merging them pairwise,
+ * round by round (a FIFO in keep).
+ * Complexity O(n)
+ */
+static Heap* _priq_heap_build(Priq q, Heap** keep, uint64_t n)
+{
+	if(!n)
+		return NULL;
+
+	uint64_t r = 0;
+	uint64_t w = n;
+
+	// n - 1 merges, each takes two heaps from the front, adds one at the back
+	for(uint64_t i = 1; i < n; ++i)
+	{
+		Heap* a = keep[r++ % n];
+		Heap* b = keep[r++ % n];
+		keep[w++ % n] = _priq_heap_merge(q, a, b);
+	}
+
+	return keep[r % n];
+}
+
+
+#ifdef PRIQ_TRACE
+// -----------------------------------------------------------------------------
+/**
+ * Opens (and truncates) the trace file once per process.
+ */
+static void _priq_trace_open(void)
+{
+	const char* name = getenv("PRIQ_TRACE_FILE");
+	_priq_trace_fd = open(name ? name : "priq.trace",
+		O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Appends the records of a buffer to the trace file and empties it.
+ * Records are dropped if the file can't be written.
+ */
+static void _priq_trace_write(struct _PriqTraceBuffer* b)
+{
+	pthread_once(&_priq_trace_open_once, _priq_trace_open);
+
+	const char* p = (const char*)b->rec;
+	size_t len = b->n * sizeof(*b->rec);
+
+	while(_priq_trace_fd >= 0 && len)
+	{
+		ssize_t w = write(_priq_trace_fd, p, len);
+		if(w <= 0)
+			break;
+		p += w;
+		len -= w;
+	}
+
+	b->n = 0;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Thread exit and process exit handlers.
+ */
+static void _priq_trace_thread_end(void* b)
+{
+	_priq_trace_write(b);
+}
+
+static void _priq_trace_exit(void)
+{
+	priq_trace_flush();
+}
+
+static void _priq_trace_init(void)
+{
+	pthread_key_create(&_priq_trace_tkey, _priq_trace_thread_end);
+	atexit(_priq_trace_exit);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Records one operation in the buffer of the calling thread.
+ * Complexity O(1), lock free
+ */
+static void _priq_trace(unsigned op, const void* q, uint64_t arg, uint64_t key)
+{
+	struct _PriqTraceBuffer* b = &_priq_trace_buf;
+
+	if(!b->active)
+	{
+		pthread_once(&_priq_trace_init_once, _priq_trace_init);
+		pthread_setspecific(_priq_trace_tkey, b);
+		b->active = true;
+	}
+
+	if(b->n == PRIQ_TRACE_BUFFER)
+		_priq_trace_write(b);
+
+	PriqTrace* r = b->rec + b->n++;
+	r->seq = ((uint64_t)op << 56)
+	       | __atomic_fetch_add(&_priq_trace_seq, 1, __ATOMIC_RELAXED);
+	r->queue = (uint64_t)(uintptr_t)q;
+	r->arg = arg;
+	r->key = key;
+}
+#endif
+
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 // FUNCTIONS EXTERN
 
+// -----------------------------------------------------------------------------
+/**
+ * Sets the key fingerprint function used for all traced elements.
+ */
+void priq_trace_key(Prikey k)
+{
+#ifdef PRIQ_TRACE
+	_priq_trace_keyf = k;
+#else
+	(void)k;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Writes the buffered records of the calling thread.
+ */
+void priq_trace_flush(void)
+{
+#ifdef PRIQ_TRACE
+	if(_priq_trace_buf.n)
+		_priq_trace_write(&_priq_trace_buf);
+#endif
+}
+
 // -----------------------------------------------------------------------------
 /**
  * Priority queue invariant check.
@@ -215,7 +858,17 @@ const char* priq_invariant(Priq q)
 	if(!q->cmp)
 		return "NULL POINTER EXCEP: Pcue compare function undefinded";
 
-	if(!q->top && priq_size(q) != 0)
+	if(_priq_is_seq(q))
+		return q->impl
+			? _priq_seq_invariant(q->impl, q->cmp, q->size)
+			: "NULL POINTER EXCEP: sequence heap undefinded";
+
+	if(_priq_is_ival(q))
+		return q->impl
+			? _priq_ival_invariant(q->impl, q->cmp, q->size)
+			: "NULL POINTER EXCEP: interval heap undefinded";
+
+	if(!q->top && priq_size(q) != q->nibuf)
 		return "WRONG STRUCTURE: top = NULL but size > 0";
 
 	if(q->top && priq_size(q) == 0)
@@ -223,15 +876,53 @@ const char* priq_invariant(Priq q)
 
 	if(!_priq_heap_inv(q->top, q->cmp))
 		return "WRONG STRUCTURE: heap invariant failed";
+
+	if(_priq_is_leftist(q) && !_priq_rank_inv(q->top, true))
+		return "WRONG STRUCTURE: leftist rank invariant failed";
 	
-	if(q->size != _priq_count_contend(q->top))
+	if(q->size != _priq_count_contend(q->top) + q->nibuf)
 		return "WRONG STRUCTURE: size != real #contend";
 
+	if(q->nibuf > q->ibuf_cap)
+		return "WRONG STRUCTURE: insertion buffer overflow";
+
+	for(uint32_t i = 1; i < q->nibuf; ++i)
+		if(q->cmp(q->ibuf[i - 1], q->ibuf[i]) < 0)
+			return "WRONG STRUCTURE: insertion buffer not sorted";
+
 	return NULL;
 }
 
 
 #ifdef INVARIANT_CHECKS
+// -----------------------------------------------------------------------------
+/**
+ * Local invariant check, run at every check point: sizes and the top
+ * node. The nodes below are checked by _priq_heap_merge when it touches
+ * them, and in full by the sampled priq_check_invariant.
+ * Complexity always O(1)
+ */
+static bool _priq_local_inv(Priq q)
+{
+	if(!q || !q->cmp)
+		return priq_check_invariant(q);
+
+	if(_priq_is_seq(q))
+		return q->impl != NULL;
+
+	if(_priq_is_ival(q))
+		return q->impl && ((PriqIval*)q->impl)->n == q->size;
+
+	if(q->nibuf > q->ibuf_cap || _priq_heap_count(q->top) + q->nibuf != q->size
+		|| !_priq_node_inv(q->top, q->cmp))
+	{
+		perr("local invariant failed");
+		return false;
+	}
+
+	return true;
+}
+
 // -----------------------------------------------------------------------------
 /**
  * Invariant check suited for assert macros. 
@@ -263,12 +954,43 @@ bool priq_check_invariant(Priq q)
  */
 Priq priq_create(Pricmp cmp)
 {
+	return priq_create_backend(cmp, PRIQ_BACKEND_SKEW);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a new priority queue with the given backend. See priq_create.
+ * Returns NULL for an unknown backend.
+ * Complexity always O(1)
+ */
+Priq priq_create_backend(Pricmp cmp, Pribackend b)
+{
+	if(b != PRIQ_BACKEND_SKEW && b != PRIQ_BACKEND_SEQUENCE
+		&& b != PRIQ_BACKEND_INTERVAL && b != PRIQ_BACKEND_LEFTIST)
+		return NULL;
+
 	Priq res = _smalloc(sizeof(*res));
 	res->cmp = cmp;
 	res->size = 0;
 	res->top = NULL;
+	res->shared = false;
+	res->spare = NULL;
+	res->nspare = 0;
+	res->backend = b;
+	res->impl = (b == PRIQ_BACKEND_SEQUENCE) ? (void*)_priq_seq_create()
+		: (b == PRIQ_BACKEND_INTERVAL) ? (void*)_priq_ival_create() : NULL;
+	res->dead = NULL;
+	res->deadfree = NULL;
+	res->max_dead = 1.0;
+	res->ndead = 0;
+	res->ibuf = NULL;
+	res->nibuf = 0;
+	res->ibuf_cap = 0;
+
+	TRACE(PRIQ_OP_CREATE, res, 0, 0);
 
-	ASSERT(priq_check_invariant(res));
+	INVARIANT(res);
 	return res;
 }
 
@@ -277,13 +999,25 @@ Priq priq_create(Pricmp cmp)
 /**
  * Destroys a queue. All memory is released.
  * Freefunc will be used on every contend unless it is NULL;
- * Complexity always O(n)
+ * Complexity always O(n), O(1) for a clone and NULL Freefunc
  */
 void priq_destroy(Priq q, Freefunc ff)
 {
-	ASSERT(priq_check_invariant(q), "priq_destroy: inv failed before");
+	INVARIANT(q, "priq_destroy: inv failed before");
+
+	TRACE(PRIQ_OP_DESTROY, q, 0, 0);
 
-	_priq_heap_destroy(q->top, ff);
+	if(_priq_is_seq(q))
+		_priq_seq_destroy(q->impl, ff);
+	else if(_priq_is_ival(q))
+		_priq_ival_destroy(q->impl, ff);
+
+	for(uint32_t i = 0; ff && i < q->nibuf; ++i)
+		ff(q->ibuf[i]);
+	free(q->ibuf);
+
+	_priq_heap_destroy(q->top, ff, true);
+	_priq_spare_destroy(q);
 
 	free(q);
 }
@@ -296,14 +1030,47 @@ void priq_destroy(Priq q, Freefunc ff)
  */
 void priq_enqueue(Priq q, cp c)
 {
-	ASSERT(priq_check_invariant(q), "priq_enqueue: inv failed before");
+	INVARIANT(q, "priq_enqueue: inv failed before");
 
-	Heap* tmp = _priq_create_heap(c);
+	TRACE(PRIQ_OP_ENQUEUE, q, (uintptr_t)c, TRACE_KEY(c));
 
-	q->top = _priq_heap_merge(q->top, tmp, q->cmp);
+	if(_priq_is_seq(q))
+	{
+		_priq_seq_insert(q->impl, c, q->cmp);
+	}
+	else if(_priq_is_ival(q))
+	{
+		_priq_ival_insert(q->impl, c, q->cmp);
+	}
+	else if(q->ibuf && (!q->top || q->cmp(c, q->top->contend) < 0))
+	{
+		_priq_ibuf_insert(q, c);
+	}
+	else
+	{
+		Heap* tmp = _priq_take_heap(q, c);
+		q->top = _priq_heap_merge(q, q->top, tmp);
+	}
 	q->size++;
 
-	ASSERT(priq_check_invariant(q), "priq_enqueue: inv failed after");
+	INVARIANT(q, "priq_enqueue: inv failed after");
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns the element with the lowest priority. But does not remove it.
+ * NULL if the queue is empty.
+ * Complexity always O(1), O(log n) for the sequence heap
+ */
+cp priq_peek(Priq q)
+{
+	if(q->dead)
+		_priq_drop_dead(q);
+
+	if(priq_is_empty(q))
+		return NULL;
+
+	return _priq_top(q);
 }
 
 // -----------------------------------------------------------------------------
@@ -313,19 +1080,66 @@ void priq_enqueue(Priq q, cp c)
  */
 cp priq_dequeue(Priq q)
 {
-	ASSERT(priq_check_invariant(q), "priq_dequeue: inv failed before");
+	INVARIANT(q, "priq_dequeue: inv failed before");
+
+	if(q->dead)
+		_priq_drop_dead(q);
 	
 	if(priq_is_empty(q))
+	{
+		TRACE(PRIQ_OP_DEQUEUE, q, 0, 0);
 		return NULL;
+	}
 
-	cp* res = priq_peek(q);
-	Heap* delme = q->top;
+	cp res = _priq_pop(q);
 
-	q->top = _priq_heap_merge(q->top->right, q->top->left, q->cmp);
-	free(delme);
-	q->size--;
+	TRACE(PRIQ_OP_DEQUEUE, q, (uintptr_t)res, TRACE_KEY(res));
+
+	INVARIANT(q, "priq_dequeue: inv failed after");
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns the element with the highest priority. But does not remove it.
+ * NULL if the queue is empty or not an interval heap.
+ * Complexity always O(1)
+ */
+cp priq_peek_max(Priq q)
+{
+	if(!_priq_is_ival(q))
+		return NULL;
+
+	if(q->dead)
+		_priq_drop_dead_max(q);
+
+	return _priq_ival_max(q->impl);
+}
 
-	ASSERT(priq_check_invariant(q), "priq_dequeue: inv failed after");
+// -----------------------------------------------------------------------------
+/**
+ * Dequeues the element with the highest priority. Returns NULL if the
+ * queue is empty or not an interval heap.
+ * Complexity always O(log n)
+ */
+cp priq_dequeue_max(Priq q)
+{
+	INVARIANT(q, "priq_dequeue_max: inv failed before");
+
+	if(!_priq_is_ival(q))
+		return NULL;
+
+	if(q->dead)
+		_priq_drop_dead_max(q);
+
+	cp res = _priq_ival_delete_max(q->impl, q->cmp);
+	if(res)
+		q->size--;
+
+	TRACE(PRIQ_OP_DEQUEUE_MAX, q, (uintptr_t)res, res ? TRACE_KEY(res) : 0);
+
+	INVARIANT(q, "priq_dequeue_max: inv failed after");
 
 	return res;
 }
@@ -335,27 +1149,297 @@ cp priq_dequeue(Priq q)
 /**
  * Merges two queues intp one. Don't use q1 or q2 after the call of 
  * this function. Only the returned queue is supposed to be touched again.
- * Returns NULL if the queues have different comparison functions.
+ * Returns NULL if the queues have different comparison functions
+ * or backends.
  * Complexity O(log n)
  */
 Priq priq_merge(Priq q1, Priq q2)
 {
-	ASSERT(priq_check_invariant(q1), "priq_merge: inv q1 failed before");
-	ASSERT(priq_check_invariant(q2), "priq_merge: inv q2 failed before");
+	INVARIANT(q1, "priq_merge: inv q1 failed before");
+	INVARIANT(q2, "priq_merge: inv q2 failed before");
 
 	if(q1 == q2)
 		return q1;
 
-	if(q1->cmp != q2->cmp)
+	if(q1->cmp != q2->cmp || q1->backend != q2->backend)
 		return NULL;
 
-	q1->top = _priq_heap_merge(q1->top, q2->top, q1->cmp);
+	TRACE(PRIQ_OP_MERGE, q1, (uintptr_t)q2, 0);
+
+	if(_priq_is_seq(q1))
+	{
+		_priq_seq_merge(q1->impl, q2->impl, q1->cmp);
+	}
+	else if(_priq_is_ival(q1))
+	{
+		_priq_ival_merge(q1->impl, q2->impl, q1->cmp);
+	}
+	else
+	{
+		_priq_ibuf_flush(q2);
+		q1->shared |= q2->shared;
+		q1->top = _priq_heap_merge(q1, q1->top, q2->top);
+	}
 	q1->size += q2->size;
+	q1->ndead += q2->ndead;
 
+	_priq_spare_destroy(q2);
+	free(q2->ibuf);
 	free(q2);
 
-	ASSERT(priq_check_invariant(q1), "priq_merge: inv failed after");
+	INVARIANT(q1, "priq_merge: inv failed after");
 
 	return q1;
 }
 
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Splits a queue. Roughly half of the elements of q (a subtree with 3/8
+ * to 3/4 of them, or the smaller half if the tree is too deep to find
+ * one) are moved into out. Both queues stay valid.
+ * Returns out, or NULL if the queues have different comparison functions
+ * or backends. The sequence heap moves whole runs and cuts the last one,
+ * the interval heap the back half of its array.
+ * Complexity skew and leftist heap O(log n), O(n log n) if too deep,
+ * sequence heap O(n) worst, interval heap O(n log n) worst
+ */
+Priq priq_split(Priq q, Priq out)
+{
+	INVARIANT(q, "priq_split: inv q failed before");
+	INVARIANT(out, "priq_split: inv out failed before");
+
+	if(q == out || q->cmp != out->cmp || q->backend != out->backend)
+		return NULL;
+
+	if(priq_size(q) < 2)
+		return out;
+
+	if(!_priq_is_tree(q))
+	{
+		uint64_t moved = _priq_is_seq(q)
+			? _priq_seq_split(q->impl, out->impl, q->cmp)
+			: _priq_ival_split(q->impl, out->impl, q->cmp);
+		_priq_move_dead(q, out, moved);
+		q->size -= moved;
+		out->size += moved;
+
+		TRACE(PRIQ_OP_SPLIT, q, (uintptr_t)out, moved);
+		return out;
+	}
+
+	_priq_ibuf_flush(q);
+
+	// go down the bigger child until it holds at most 3/4 of the elements,
+	// its parent holds more, so it gets at least about 3/8 of them
+	Heap* path[PRIQ_SPLIT_DEPTH];
+	unsigned depth = 0;
+	Heap** link = &q->top;
+	uint64_t n = q->top->count;
+	Heap* h;
+	Heap* part;
+	uint64_t moved;
+
+	for(;;)
+	{
+		h = *link = _priq_own_heap(q, *link);
+		path[depth++] = h;
+
+		link = _priq_heap_count(h->left) >= _priq_heap_count(h->right)
+			? &h->left : &h->right;
+		if(4 * (*link)->count <= 3 * n || depth == PRIQ_SPLIT_DEPTH)
+			break;
+	}
+
+	// too deep for a subtree of about half size, move half node by node
+	if(4 * (*link)->count > 3 * n)
+	{
+		moved = n / 2;
+		TRACE(PRIQ_OP_SPLIT, q, (uintptr_t)out, moved);
+
+		_priq_split_nodes(q, out, moved);
+		_priq_move_dead(q, out, moved);
+		q->size -= moved;
+		out->size += moved;
+
+		INVARIANT(q, "priq_split: inv q failed after");
+		INVARIANT(out, "priq_split: inv out failed after");
+
+		return out;
+	}
+
+	// the other one stays as left child
+	part = *link;
+	moved = part->count;
+	if(link == &h->left)
+		h->left = h->right;
+	h->right = NULL;
+	TRACE(PRIQ_OP_SPLIT, q, (uintptr_t)out, moved);
+
+	while(depth--)
+	{
+		h = path[depth];
+		h->count -= moved;
+
+		if(_priq_is_leftist(q) && _priq_heap_rank(h->left) < _priq_heap_rank(h->right))
+		{
+			Heap* t = h->left;
+			h->left = h->right;
+			h->right = t;
+		}
+		h->rank = 1 + _priq_heap_rank(h->right);
+	}
+
+	_priq_move_dead(q, out, moved);
+	q->size -= moved;
+
+	out->shared |= q->shared;
+	out->top = _priq_heap_merge(out, out->top, part);
+	out->size += moved;
+
+	INVARIANT(q, "priq_split: inv q failed after");
+	INVARIANT(out, "priq_split: inv out failed after");
+
+	return out;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a copy of a queue that shares all nodes with it.
+ * Returns NULL for the sequence and the interval heap.
+ * Complexity always O(1)
+ */
+Priq priq_clone(Priq q)
+{
+	INVARIANT(q, "priq_clone: inv failed before");
+
+	if(!_priq_is_tree(q))
+		return NULL;
+
+	Priq res = _smalloc(sizeof(*res));
+	q->shared = true;
+	*res = *q;
+	res->spare = NULL;
+	res->nspare = 0;
+
+	if(res->top)
+		res->top->refs++;
+
+	if(q->ibuf)
+	{
+		res->ibuf = _smalloc(q->ibuf_cap * sizeof(cp));
+		memcpy(res->ibuf, q->ibuf, q->nibuf * sizeof(cp));
+	}
+
+	TRACE(PRIQ_OP_CLONE, q, (uintptr_t)res, 0);
+
+	INVARIANT(res, "priq_clone: inv failed after");
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes all elements for which pred is true, Freefunc is used on them
+ * unless it is NULL. Returns the number of removed elements.
+ * Complexity always O(n)
+ */
+uint64_t priq_remove_if(Priq q, Pripred pred, Freefunc ff)
+{
+	INVARIANT(q, "priq_remove_if: inv failed before");
+
+	uint64_t removed;
+
+	if(_priq_is_seq(q))
+	{
+		removed = _priq_seq_remove_if(q->impl, pred, ff, q->cmp);
+	}
+	else if(_priq_is_ival(q))
+	{
+		removed = _priq_ival_remove_if(q->impl, pred, ff, q->cmp);
+	}
+	else
+	{
+		Heap** keep = _smalloc((priq_size(q) ? priq_size(q) : 1) * sizeof(*keep));
+		uint64_t nkeep = 0;
+
+		uint32_t n = 0;
+		for(uint32_t i = 0; i < q->nibuf; ++i)
+		{
+			if(!pred(q->ibuf[i]))
+				q->ibuf[n++] = q->ibuf[i];
+			else if(ff != NULL)
+				ff(q->ibuf[i]);
+		}
+		q->nibuf = n;
+
+		_priq_heap_filter(q, q->top, true, pred, ff, keep, &nkeep);
+		q->top = _priq_heap_build(q, keep, nkeep);
+		removed = priq_size(q) - nkeep - n;
+
+		free(keep);
+	}
+
+	q->size -= removed;
+	q->ndead = (q->dead == pred) ? 0 : (q->ndead < removed ? 0 : q->ndead - removed);
+
+	INVARIANT(q, "priq_remove_if: inv failed after");
+	return removed;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Turns on tombstone mode, dead = NULL turns it off.
+ * Complexity always O(1)
+ */
+void priq_tombstones(Priq q, Pripred dead, Freefunc ff, double max_dead)
+{
+	q->dead = dead;
+	q->deadfree = ff;
+	q->max_dead = max_dead;
+	q->ndead = 0;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Tells a queue in tombstone mode that n more of its elements are dead.
+ * Complexity O(1), O(n) if it compacts the queue
+ */
+void priq_mark_dead(Priq q, uint64_t n)
+{
+	if(!q->dead)
+		return;
+
+	q->ndead += n;
+
+	if(q->ndead > q->max_dead * priq_size(q))
+		priq_remove_if(q, q->dead, q->deadfree);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Puts a small sorted buffer of up to capacity elements in front of the
+ * skew or leftist heap, capacity 0 turns it off.
+ * Returns false for the sequence and the interval heap or
+ * capacity > PRIQ_IBUF_MAX.
+ * Complexity O(capacity)
+ */
+bool priq_insertion_buffer(Priq q, unsigned capacity)
+{
+	if(!_priq_is_tree(q) || capacity > PRIQ_IBUF_MAX)
+		return false;
+
+	_priq_ibuf_flush(q);
+	free(q->ibuf);
+
+	q->ibuf = capacity ? _smalloc(capacity * sizeof(cp)) : NULL;
+	q->ibuf_cap = capacity;
+
+	INVARIANT(q, "priq_insertion_buffer: inv failed after");
+	return true;
+}
@@ -28,6 +28,12 @@ struct _Heap
 	struct _Heap* right;
 	/** The left heap  */
 	struct _Heap* left;
+	/** Number of nodes in this heap (this node included) */
+	uint64_t count;
+	/** Number of queues and nodes pointing to this node, see priq_clone */
+	uint32_t refs;
+	/** Length of the right spine, kept by PRIQ_BACKEND_LEFTIST only */
+	uint32_t rank;
 };
 
 typedef struct _Heap Heap;
@@ -38,12 +44,58 @@ typedef int(*Pricmp)(cp c1, cp c2);
 // Used for contend deletion, see priq_destroy
 typedef void(*Freefunc)(cp c);
 
+// Used for contend selection, see priq_remove_if
+typedef bool(*Pripred)(cp c);
+
+// Data structure behind a queue, see priq_create_backend
+typedef enum
+{
+	/** Pointer based skew heap, the default */
+	PRIQ_BACKEND_SKEW = 0,
+	/** Cache efficient sequence heap for very large queues */
+	PRIQ_BACKEND_SEQUENCE,
+	/** Array based interval heap, double ended, see priq_dequeue_max */
+	PRIQ_BACKEND_INTERVAL,
+	/** Pointer based leftist heap, worst case O(log n) */
+	PRIQ_BACKEND_LEFTIST,
+} Pribackend;
+
+// Maximum number of released nodes a queue keeps for reuse
+#ifndef PRIQ_NODE_CACHE
+	#define PRIQ_NODE_CACHE 64
+#endif
+
+// Maximum depth priq_split goes down to find a subtree of about half size
+#ifndef PRIQ_SPLIT_DEPTH
+	#define PRIQ_SPLIT_DEPTH 64
+#endif
+
+// Maximum capacity of the insertion buffer, see priq_insertion_buffer
+#define PRIQ_IBUF_MAX 64
+
 // Base structure (Can't be opaque because of macro based interface)
 struct _Priq
 {
 	uint64_t size;
 	Heap* top;
 	Pricmp cmp;
+	/** Released nodes, linked by right. Reused by priq_enqueue */
+	Heap* spare;
+	uint64_t nspare;
+	Pribackend backend;
+	/** Backend data if the backend is not made of Heap nodes */
+	void* impl;
+	/** Nodes may be shared with a clone, set by priq_clone, see refs */
+	bool shared;
+	/** Tombstone mode, see priq_tombstones */
+	Pripred dead;
+	Freefunc deadfree;
+	double max_dead;
+	uint64_t ndead;
+	/** Insertion buffer, sorted descending, see priq_insertion_buffer */
+	cp* ibuf;
+	uint32_t nibuf;
+	uint32_t ibuf_cap;
 };
 
 // Just 'Priq' for the main data structure
@@ -84,11 +136,34 @@ typedef struct _Priq* Priq;
 Priq priq_create(Pricmp cmp);
 
 
+// -----------------------------------------------------------------------------
+/**
+ * Creates a new priority queue with the given backend. See priq_create.
+ * PRIQ_BACKEND_SEQUENCE is a sequence heap: enqueue and dequeue are
+ * amortized O(log n) but touch memory mostly sequentially, which pays off
+ * for queues much bigger than the cache. priq_merge and priq_split are
+ * O(n) worst for it.
+ * PRIQ_BACKEND_INTERVAL is an interval heap, which can also return the
+ * element with the highest priority, see priq_dequeue_max. priq_merge
+ * and priq_split are O(n log n) worst for it.
+ * PRIQ_BACKEND_LEFTIST is a leftist heap: the same nodes as the skew
+ * heap plus a rank, every merge of two trees is worst case O(log n)
+ * instead of amortized. For tail latency sensitive queues, without the
+ * insertion buffer and tombstones (see priq_enqueue and priq_dequeue).
+ * Returns NULL for an unknown backend.
+ * Complexity always O(1)
+ */
+Priq priq_create_backend(Pricmp cmp, Pribackend b);
+
+
 // -----------------------------------------------------------------------------
 /**
  * Destroys a queue. All memory is released.
  * Freefunc will be used on every contend unless it is NULL;
- * Complexity always O(n)
+ * Nodes shared with a clone are kept for the clone, but Freefunc is still
+ * used on their contend: with clones it is called once per queue holding
+ * an element, so it should drop a reference rather than free.
+ * Complexity always O(n), O(1) for a clone and NULL Freefunc
  */
 void priq_destroy(Priq q, Freefunc f);
 
@@ -97,15 +172,17 @@ void priq_destroy(Priq q, Freefunc f);
 /**
  * Returns the element with the lowest priority. But does not remove it.
  * NULL if the queue is empty.
- * Complexity always O(1)
+ * Complexity always O(1), O(log n) for the sequence heap
  */
-#define priq_peek(q) ((priq_is_empty(q)) ? NULL : q->top->contend)
+cp priq_peek(Priq q);
 
 
 // -----------------------------------------------------------------------------
 /**
  * Enqueues an element into the queue.
- * Complexity O(log n)
+ * Complexity O(log n), amortized. Worst case for the leftist heap unless
+ * the insertion buffer is on: the enqueue that finds it full flushes it,
+ * O(capacity + log n), see priq_insertion_buffer.
  */
 void priq_enqueue(Priq q, cp c);
  
@@ -113,21 +190,139 @@ void priq_enqueue(Priq q, cp c);
 // -----------------------------------------------------------------------------
 /**
  * Dequeues an element from the queue. Return NULL if the queue is empty.
- * Complexity O(log n)
+ * Complexity O(log n), amortized. Worst case for the leftist heap unless
+ * tombstones are on: every dead top element skipped costs O(log n) more,
+ * see priq_tombstones.
  */
 cp priq_dequeue(Priq q);
 
 
+// -----------------------------------------------------------------------------
+/**
+ * Same as priq_peek and priq_dequeue, named after their double ended
+ * counterparts priq_peek_max and priq_dequeue_max.
+ */
+#define priq_peek_min(q) priq_peek(q)
+#define priq_dequeue_min(q) priq_dequeue(q)
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns the element with the highest priority. But does not remove it.
+ * NULL if the queue is empty or its backend is not PRIQ_BACKEND_INTERVAL,
+ * check priq_size to tell them apart.
+ * Complexity always O(1)
+ */
+cp priq_peek_max(Priq q);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Dequeues the element with the highest priority. Returns NULL if the
+ * queue is empty or its backend is not PRIQ_BACKEND_INTERVAL, check
+ * priq_size to tell them apart.
+ * Complexity O(log n)
+ */
+cp priq_dequeue_max(Priq q);
+
+
 // -----------------------------------------------------------------------------
 /**
  * Merges two queues intp one. Don't use q1 or q2 after the call of 
  * this function. Only the returned queue is supposed to be touched again.
- * Returns NULL if the queues have different comparison functions.
- * Complexity O(log n)
+ * Returns NULL if the queues have different comparison functions
+ * or backends.
+ * Complexity O(log n), amortized but worst case for the leftist heap,
+ * plus the flush of both insertion buffers (see priq_enqueue)
  */
 Priq priq_merge(Priq q1, Priq q2);
 
 
+// -----------------------------------------------------------------------------
+/**
+ * Splits a queue. Roughly half of the elements of q are moved into out.
+ * Both queues stay valid.
+ * Returns out, or NULL if the queues have different comparison functions
+ * or backends.
+ * Tree backends move a subtree, no element is touched on its own:
+ * priq_split goes down the bigger child until it holds at most 3/4 of
+ * the elements, so out gets about 3/8 to 3/4 of them. If there is no
+ * such child within PRIQ_SPLIT_DEPTH levels, as after monotone input,
+ * the smaller half of the elements is moved node by node instead.
+ * The sequence heap moves whole runs and cuts the last one, the interval
+ * heap inserts the back half of its array into out. Both move half.
+ * Complexity skew and leftist heap O(log n), O(n log n) for the node by
+ * node move, sequence heap O(n) worst, interval heap O(n log n) worst
+ */
+Priq priq_split(Priq q, Priq out);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a copy of a queue that shares all nodes with it. Changes to
+ * either queue only copy the nodes they touch (path copying), so both
+ * behave like independent queues. Returns NULL for the sequence and
+ * the interval heap.
+ * A queue and its clones share unsynchronized reference counts, use them
+ * from one thread at a time.
+ * The elements are shared as well, and the clone keeps the tombstone mode
+ * of q. Every Freefunc (priq_destroy, priq_remove_if, priq_tombstones) is
+ * called once per queue that drops an element, so with clones it should
+ * drop a reference rather than free.
+ * Complexity always O(1)
+ */
+Priq priq_clone(Priq q);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes all elements for which pred is true, Freefunc is used on them
+ * unless it is NULL. One pass over all elements, the rest is rebuilt
+ * by pairwise merging. Returns the number of removed elements.
+ * Elements still held by a clone stay there, ff runs for this queue's
+ * reference only, see priq_clone.
+ * Complexity always O(n)
+ */
+uint64_t priq_remove_if(Priq q, Pripred pred, Freefunc ff);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Turns on tombstone mode. Elements for which dead is true are skipped
+ * (and released with Freefunc unless it is NULL) by priq_peek,
+ * priq_dequeue and their _max counterparts. Report killed elements with
+ * priq_mark_dead; once more than max_dead of the elements are dead they
+ * are removed with priq_remove_if. dead = NULL turns the mode off.
+ * priq_size counts dead elements until they are skipped or removed.
+ * Clones keep the mode, each of them releases the dead elements it
+ * skips, see priq_clone.
+ * Complexity always O(1)
+ */
+void priq_tombstones(Priq q, Pripred dead, Freefunc ff, double max_dead);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Tells a queue in tombstone mode that n more of its elements are dead.
+ * Complexity O(1), O(n) if it compacts the queue
+ */
+void priq_mark_dead(Priq q, uint64_t n);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Puts a small sorted buffer of up to capacity elements in front of the
+ * skew or leftist heap. Elements that would become the new top go into
+ * the buffer, and are dequeued from there without touching the heap. A
+ * full buffer is merged into the heap as one batch. capacity 0 turns it
+ * off.
+ * Returns false for the sequence and the interval heap or
+ * capacity > PRIQ_IBUF_MAX.
+ * Complexity O(capacity)
+ */
+bool priq_insertion_buffer(Priq q, unsigned capacity);
+
+
 // -----------------------------------------------------------------------------
 /**
  * Priority queue invariant check.
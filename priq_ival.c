@@ -0,0 +1,350 @@
+/**
+ * Interval heap backend of priq.
+ */
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// HEADER
+
+#include "priq_ival.h"
+#include <stdlib.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS INTERN
+
+// Parent node of the node holding slot s (s >= 2)
+#define _priq_ival_parent(s) (((s) / 2 - 1) / 2)
+// Slot acting as high of node i, the low if the node holds one element
+#define _priq_ival_high(i, n) ((2 * (i) + 1 < (n)) ? 2 * (i) + 1 : 2 * (i))
+
+// -----------------------------------------------------------------------------
+/**
+ * Safe realloc.
+ */
+static void* _priq_ival_realloc(void* p, uint64_t s)
+{
+	void* res = realloc(p, s);
+	if (!res)
+		abort();
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves c up from the free slot s along the lows (min heap) or the
+ * highs (max heap).
+ * Complexity O(log n)
+ */
+static void _priq_ival_up_low(cp* a, uint64_t s, cp c, Pricmp cmp)
+{
+	while(s >= 2 && cmp(c, a[2 * _priq_ival_parent(s)]) < 0)
+	{
+		uint64_t p = 2 * _priq_ival_parent(s);
+		a[s] = a[p];
+		s = p;
+	}
+	a[s] = c;
+}
+
+static void _priq_ival_up_high(cp* a, uint64_t s, cp c, Pricmp cmp)
+{
+	while(s >= 2 && cmp(c, a[2 * _priq_ival_parent(s) + 1]) > 0)
+	{
+		uint64_t p = 2 * _priq_ival_parent(s) + 1;
+		a[s] = a[p];
+		s = p;
+	}
+	a[s] = c;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates an empty interval heap.
+ * Complexity always O(1)
+ */
+PriqIval* _priq_ival_create(void)
+{
+	PriqIval* v = _priq_ival_realloc(NULL, sizeof(*v));
+	v->a = NULL;
+	v->n = 0;
+	v->cap = 0;
+	return v;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys an interval heap, ff is used on every element unless NULL.
+ * Complexity always O(n)
+ */
+void _priq_ival_destroy(PriqIval* v, Freefunc ff)
+{
+	for(uint64_t i = 0; ff && i < v->n; ++i)
+		ff(v->a[i]);
+
+	free(v->a);
+	free(v);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Inserts an element. It goes to the last node, as its high if the node
+ * is taken, and moves up the side it belongs to.
+ * Complexity O(log n), amortized for the array growth
+ */
+void _priq_ival_insert(PriqIval* v, cp c, Pricmp cmp)
+{
+	if(v->n == v->cap)
+	{
+		v->cap = v->cap ? 2 * v->cap : PRIQ_IVAL_INITIAL;
+		v->a = _priq_ival_realloc(v->a, v->cap * sizeof(cp));
+	}
+
+	cp* a = v->a;
+	uint64_t s = v->n++;
+
+	if(s & 1)
+	{
+		if(cmp(c, a[s - 1]) < 0)
+		{
+			a[s] = a[s - 1];
+			_priq_ival_up_low(a, s - 1, c, cmp);
+		}
+		else
+		{
+			_priq_ival_up_high(a, s, c, cmp);
+		}
+	}
+	else if(s >= 2 && cmp(c, a[2 * _priq_ival_parent(s)]) < 0)
+	{
+		_priq_ival_up_low(a, s, c, cmp);
+	}
+	else
+	{
+		_priq_ival_up_high(a, s, c, cmp);
+	}
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns the smallest / biggest element, NULL if empty.
+ * Complexity always O(1)
+ */
+cp _priq_ival_min(PriqIval* v)
+{
+	return v->n ? v->a[0] : NULL;
+}
+
+cp _priq_ival_max(PriqIval* v)
+{
+	return v->n ? v->a[v->n > 1] : NULL;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the smallest element, NULL if empty. The last
+ * element moves down the lows from the root, swapping with the high of
+ * a node it is bigger than.
+ * Complexity O(log n)
+ */
+cp _priq_ival_delete_min(PriqIval* v, Pricmp cmp)
+{
+	if(!v->n)
+		return NULL;
+
+	cp* a = v->a;
+	cp res = a[0];
+	uint64_t n = --v->n;
+	cp x = a[n];
+	uint64_t i = 0;
+
+	if(!n)
+		return res;
+
+	for(;;)
+	{
+		if(2 * i + 1 < n && cmp(x, a[2 * i + 1]) > 0)
+		{
+			cp t = a[2 * i + 1];
+			a[2 * i + 1] = x;
+			x = t;
+		}
+
+		uint64_t m = 2 * i + 1;
+		if(2 * m >= n)
+			break;
+		if(2 * m + 2 < n && cmp(a[2 * m + 2], a[2 * m]) < 0)
+			m++;
+		if(cmp(x, a[2 * m]) <= 0)
+			break;
+
+		a[2 * i] = a[2 * m];
+		i = m;
+	}
+	a[2 * i] = x;
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the biggest element, NULL if empty. The last
+ * element moves down the highs from the root, swapping with the low of
+ * a node it is smaller than.
+ * Complexity O(log n)
+ */
+cp _priq_ival_delete_max(PriqIval* v, Pricmp cmp)
+{
+	if(v->n < 2)
+		return v->n ? v->a[--v->n] : NULL;
+
+	cp* a = v->a;
+	cp res = a[1];
+	uint64_t n = --v->n;
+	cp x = a[n];
+	uint64_t i = 0;
+
+	// the root keeps its low only
+	if(n == 1)
+		return res;
+
+	for(;;)
+	{
+		if(cmp(x, a[2 * i]) < 0)
+		{
+			cp t = a[2 * i];
+			a[2 * i] = x;
+			x = t;
+		}
+
+		uint64_t m = 2 * i + 1;
+		if(2 * m >= n)
+			break;
+
+		uint64_t h = _priq_ival_high(m, n);
+		if(2 * m + 2 < n && cmp(a[_priq_ival_high(m + 1, n)], a[h]) > 0)
+		{
+			m++;
+			h = _priq_ival_high(m, n);
+		}
+		if(cmp(x, a[h]) >= 0)
+			break;
+
+		a[2 * i + 1] = a[h];
+
+		// a node with one element, x takes its place
+		if(h == 2 * m)
+		{
+			a[h] = x;
+			return res;
+		}
+		i = m;
+	}
+	a[2 * i + 1] = x;
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves all elements of v2 into v1 and frees v2. The elements of the
+ * smaller heap are inserted into the bigger one.
+ * Complexity O(m log n), m the smaller size
+ */
+void _priq_ival_merge(PriqIval* v1, PriqIval* v2, Pricmp cmp)
+{
+	if(v2->n > v1->n)
+	{
+		PriqIval t = *v1;
+		*v1 = *v2;
+		*v2 = t;
+	}
+
+	for(uint64_t i = 0; i < v2->n; ++i)
+		_priq_ival_insert(v1, v2->a[i], cmp);
+
+	_priq_ival_destroy(v2, NULL);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves the back half of the array into out. Any prefix of the array is
+ * a valid interval heap, so v just gets shorter.
+ * Returns the number of moved elements.
+ * Complexity O(n log n) worst, O(n) expected
+ */
+uint64_t _priq_ival_split(PriqIval* v, PriqIval* out, Pricmp cmp)
+{
+	uint64_t moved = v->n / 2;
+
+	for(uint64_t i = v->n - moved; i < v->n; ++i)
+		_priq_ival_insert(out, v->a[i], cmp);
+	v->n -= moved;
+
+	return moved;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes all elements for which pred is true. The kept elements are
+ * compacted and inserted again in array order, which mostly finds them
+ * in place already.
+ * Returns the number of removed elements.
+ * Complexity O(n log n) worst, O(n) expected
+ */
+uint64_t _priq_ival_remove_if(PriqIval* v, Pripred pred, Freefunc ff, Pricmp cmp)
+{
+	uint64_t n = 0;
+
+	for(uint64_t i = 0; i < v->n; ++i)
+	{
+		if(!pred(v->a[i]))
+			v->a[n++] = v->a[i];
+		else if(ff)
+			ff(v->a[i]);
+	}
+
+	uint64_t removed = v->n - n;
+
+	// insert never writes behind its new element
+	v->n = 0;
+	for(uint64_t i = 0; i < n; ++i)
+		_priq_ival_insert(v, v->a[i], cmp);
+
+	return removed;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Interval heap invariant: low <= high in every node, and every node lies
+ * in the interval of its parent.
+ * Complexity always O(n)
+ * @return If NULL -> Ok. Else an error msg.
+ */
+const char* _priq_ival_invariant(PriqIval* v, Pricmp cmp, uint64_t size)
+{
+	if(v->n != size)
+		return "WRONG STRUCTURE: size != real #contend";
+
+	if(v->n > v->cap)
+		return "WRONG STRUCTURE: interval heap overflow";
+
+	for(uint64_t s = 0; s < v->n; ++s)
+	{
+		if((s & 1) && cmp(v->a[s - 1], v->a[s]) > 0)
+			return "WRONG STRUCTURE: interval heap low > high";
+
+		if(s < 2)
+			continue;
+
+		uint64_t p = _priq_ival_parent(s);
+		if(cmp(v->a[2 * p], v->a[s]) > 0 || cmp(v->a[s], v->a[2 * p + 1]) > 0)
+			return "WRONG STRUCTURE: interval heap order failed";
+	}
+
+	return NULL;
+}
@@ -0,0 +1,52 @@
+/**
+ * Interval heap backend of priq (internal, see PRIQ_BACKEND_INTERVAL).
+ *
+ * After J. van Leeuwen and D. Wood, "Interval heaps".
+ * A complete binary tree in an array, every node holds two elements,
+ * low <= high (the last node may hold only one). The lows form a min heap,
+ * the highs a max heap, and the interval of a node contains the intervals
+ * of its children. The smallest element is the low of the root, the
+ * biggest its high.
+ */
+
+#ifndef _PRIQ_IVAL_H_
+#define _PRIQ_IVAL_H_
+
+#include "priq.h"
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+// Initial array capacity
+#ifndef PRIQ_IVAL_INITIAL
+	#define PRIQ_IVAL_INITIAL 16
+#endif
+
+struct _PriqIval
+{
+	/** Node i holds a[2i] (low) and a[2i + 1] (high) */
+	cp* a;
+	uint64_t n;
+	uint64_t cap;
+};
+
+typedef struct _PriqIval PriqIval;
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// INTERFACE (intern)
+
+PriqIval* _priq_ival_create(void);
+void _priq_ival_destroy(PriqIval* v, Freefunc ff);
+void _priq_ival_insert(PriqIval* v, cp c, Pricmp cmp);
+cp _priq_ival_min(PriqIval* v);
+cp _priq_ival_max(PriqIval* v);
+cp _priq_ival_delete_min(PriqIval* v, Pricmp cmp);
+cp _priq_ival_delete_max(PriqIval* v, Pricmp cmp);
+void _priq_ival_merge(PriqIval* v1, PriqIval* v2, Pricmp cmp);
+uint64_t _priq_ival_split(PriqIval* v, PriqIval* out, Pricmp cmp);
+uint64_t _priq_ival_remove_if(PriqIval* v, Pripred pred, Freefunc ff, Pricmp cmp);
+const char* _priq_ival_invariant(PriqIval* v, Pricmp cmp, uint64_t size);
+
+#endif
@@ -0,0 +1,293 @@
+/**
+ * Single threaded C++20 coroutine deadline scheduler on top of priq.
+ *
+ * Optional, header only. Needs -std=c++20 and libpriq.
+ *
+ *     priq::task worker(int id)
+ *     {
+ *         co_await priq::sleep_for(std::chrono::milliseconds(10));
+ *         co_await priq::yield(id);
+ *     }
+ *
+ *     priq::scheduler s;
+ *     s.spawn(worker(1));
+ *     s.run();
+ *
+ * Suspended coroutines wait in a Priq, sleepers keyed by deadline and
+ * yielded ones by priority (lower runs first). The queue entry lives in
+ * the coroutine promise and priq reuses released nodes, so a suspension
+ * doesn't allocate.
+ */
+
+#ifndef _PRIQ_SCHED_HPP_
+#define _PRIQ_SCHED_HPP_
+
+#include "priq.h"
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <utility>
+
+namespace priq {
+
+class scheduler;
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+using clock = std::chrono::steady_clock;
+
+// Queue entry of a suspended coroutine
+struct wait_node
+{
+	/** Deadline in clock ticks for sleepers, priority for yielded ones */
+	int64_t key;
+	/** Insertion order, keeps equal keys FIFO */
+	uint64_t seq;
+	std::coroutine_handle<> handle;
+};
+
+// -----------------------------------------------------------------------------
+/**
+ * Coroutine type run by the scheduler. Starts suspended, spawn it to run it.
+ * The frame is destroyed by the scheduler when the coroutine finishes.
+ */
+class task
+{
+public:
+	struct promise_type
+	{
+		wait_node node;
+
+		task get_return_object()
+		{
+			return task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept { std::terminate(); }
+	};
+
+	using handle_type = std::coroutine_handle<promise_type>;
+
+	task(task&& o) noexcept : h(std::exchange(o.h, nullptr)) {}
+	task(const task&) = delete;
+	task& operator=(const task&) = delete;
+	task& operator=(task&&) = delete;
+	~task() { if(h) h.destroy(); }
+
+	/** Gives the frame away, the caller is responsible for it now */
+	handle_type release() noexcept { return std::exchange(h, nullptr); }
+
+private:
+	explicit task(handle_type h) : h(h) {}
+
+	handle_type h;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// SCHEDULER
+
+class scheduler
+{
+public:
+	scheduler()
+		: timers(priq_create(compare)), ready(priq_create(compare))
+	{}
+
+	~scheduler()
+	{
+		destroy_all(timers);
+		destroy_all(ready);
+	}
+
+	scheduler(const scheduler&) = delete;
+	scheduler& operator=(const scheduler&) = delete;
+
+	// -------------------------------------------------------------------------
+	/**
+	 * Takes a task over and makes it ready with priority 0.
+	 * Complexity O(log n)
+	 */
+	void spawn(task t)
+	{
+		task::handle_type h = t.release();
+		enqueue(ready, h.promise().node, 0, h);
+		live++;
+	}
+
+	// -------------------------------------------------------------------------
+	/**
+	 * Runs until every spawned task is done. Due sleepers run in deadline
+	 * order before ready ones, an idle loop sleeps until the next deadline.
+	 */
+	void run()
+	{
+		scheduler* outer = std::exchange(current(), this);
+
+		while(live)
+		{
+			if(!priq_is_empty(timers))
+			{
+				int64_t now = clock::now().time_since_epoch().count();
+				wait_node* n = static_cast<wait_node*>(priq_peek(timers));
+
+				if(n->key <= now)
+				{
+					priq_dequeue(timers);
+					resume(n->handle);
+					continue;
+				}
+
+				if(priq_is_empty(ready))
+				{
+					std::this_thread::sleep_until(clock::time_point(clock::duration(n->key)));
+					continue;
+				}
+			}
+
+			wait_node* n = static_cast<wait_node*>(priq_dequeue(ready));
+			if(!n)
+				break;
+			resume(n->handle);
+		}
+
+		current() = outer;
+	}
+
+	/** Number of spawned and not yet finished tasks */
+	uint64_t tasks() const noexcept { return live; }
+
+	/** Number of coroutine resumptions so far */
+	uint64_t switches() const noexcept { return resumed; }
+
+	/** The scheduler running on this thread, nullptr outside of run */
+	static scheduler*& current() noexcept
+	{
+		static thread_local scheduler* s = nullptr;
+		return s;
+	}
+
+	// -------------------------------------------------------------------------
+	// Awaitables, use the free functions below
+
+	struct sleep_awaiter
+	{
+		clock::time_point deadline;
+
+		bool await_ready() const noexcept { return deadline <= clock::now(); }
+		void await_suspend(task::handle_type h) const noexcept
+		{
+			scheduler* s = current();
+			s->enqueue(s->timers, h.promise().node,
+			           deadline.time_since_epoch().count(), h);
+		}
+		void await_resume() const noexcept {}
+	};
+
+	struct yield_awaiter
+	{
+		int64_t priority;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(task::handle_type h) const noexcept
+		{
+			scheduler* s = current();
+			s->enqueue(s->ready, h.promise().node, priority, h);
+		}
+		void await_resume() const noexcept {}
+	};
+
+private:
+	// -------------------------------------------------------------------------
+	/**
+	 * Orders by key, then by insertion.
+	 */
+	static int compare(cp c1, cp c2)
+	{
+		const wait_node* n1 = static_cast<const wait_node*>(c1);
+		const wait_node* n2 = static_cast<const wait_node*>(c2);
+
+		if(n1->key != n2->key)
+			return (n1->key > n2->key) - (n1->key < n2->key);
+		return (n1->seq > n2->seq) - (n1->seq < n2->seq);
+	}
+
+	void enqueue(Priq q, wait_node& n, int64_t key, std::coroutine_handle<> h)
+	{
+		n.key = key;
+		n.seq = seq++;
+		n.handle = h;
+		priq_enqueue(q, &n);
+	}
+
+	void resume(std::coroutine_handle<> h)
+	{
+		resumed++;
+		h.resume();
+		if(h.done())
+		{
+			h.destroy();
+			live--;
+		}
+	}
+
+	static void destroy_all(Priq q)
+	{
+		while(!priq_is_empty(q))
+			static_cast<wait_node*>(priq_dequeue(q))->handle.destroy();
+		priq_destroy(q, nullptr);
+	}
+
+	Priq timers;
+	Priq ready;
+	uint64_t seq = 0;
+	uint64_t live = 0;
+	uint64_t resumed = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// AWAITABLES
+
+// -----------------------------------------------------------------------------
+/**
+ * Suspends the calling task until t. Only valid inside scheduler::run.
+ * Complexity O(log n)
+ */
+inline scheduler::sleep_awaiter sleep_until(clock::time_point t)
+{
+	return {t};
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Suspends the calling task for d. Only valid inside scheduler::run.
+ * Complexity O(log n)
+ */
+template<class Rep, class Period>
+inline scheduler::sleep_awaiter sleep_for(std::chrono::duration<Rep, Period> d)
+{
+	return {clock::now() + std::chrono::duration_cast<clock::duration>(d)};
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Lets other ready tasks run first. Lower priority values run earlier,
+ * equal ones in FIFO order. Only valid inside scheduler::run.
+ * Complexity O(log n)
+ */
+inline scheduler::yield_awaiter yield(int64_t priority = 0)
+{
+	return {priority};
+}
+
+} // namespace priq
+
+#endif
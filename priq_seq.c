@@ -0,0 +1,591 @@
+/**
+ * Sequence heap backend of priq.
+ */
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// HEADER
+
+#include "priq_seq.h"
+#include <stdlib.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS INTERN
+
+static void _priq_seq_add_run(PriqSeq* s, unsigned lv, struct _PriqRun run, Pricmp cmp);
+
+// -----------------------------------------------------------------------------
+
+#define _priq_run_size(r) ((r)->end - (r)->head)
+#define _priq_run_front(l, i) ((l)->runs[i].data[(l)->runs[i].head])
+
+// -----------------------------------------------------------------------------
+/**
+ * Safe malloc.
+ */
+static void* _priq_seq_malloc(uint64_t s)
+{
+	void* res = malloc(s);
+	if (!res)
+		abort();
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Insertion heap: restores the heap order upwards / downwards.
+ * Complexity O(log PRIQ_SEQ_INSERT)
+ */
+static void _priq_seq_sift_up(cp* h, unsigned i, Pricmp cmp)
+{
+	cp c = h[i];
+	while(i > 0 && cmp(h[(i - 1) / 2], c) > 0)
+	{
+		h[i] = h[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	h[i] = c;
+}
+
+static void _priq_seq_sift_down(cp* h, unsigned n, unsigned i, Pricmp cmp)
+{
+	cp c = h[i];
+	for(;;)
+	{
+		unsigned m = 2 * i + 1;
+		if(m >= n)
+			break;
+		if(m + 1 < n && cmp(h[m + 1], h[m]) < 0)
+			m++;
+		if(cmp(c, h[m]) <= 0)
+			break;
+		h[i] = h[m];
+		i = m;
+	}
+	h[i] = c;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Tournament over the run fronts of a level: same sifts, but on run indices.
+ */
+static void _priq_seq_tsift_down(struct _PriqLevel* l, uint8_t* t, unsigned n,
+	unsigned i, Pricmp cmp)
+{
+	uint8_t r = t[i];
+	for(;;)
+	{
+		unsigned m = 2 * i + 1;
+		if(m >= n)
+			break;
+		if(m + 1 < n && cmp(_priq_run_front(l, t[m + 1]), _priq_run_front(l, t[m])) < 0)
+			m++;
+		if(cmp(_priq_run_front(l, r), _priq_run_front(l, t[m])) <= 0)
+			break;
+		t[i] = t[m];
+		i = m;
+	}
+	t[i] = r;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * k-way merges the runs of a level into out, at most limit elements.
+ * If from is not NULL the source run of every element is stored there.
+ * Returns the number of merged elements.
+ * Complexity O(limit log PRIQ_SEQ_WAYS)
+ */
+static uint64_t _priq_seq_kmerge(struct _PriqLevel* l, cp* out, uint8_t* from,
+	uint64_t limit, Pricmp cmp)
+{
+	uint8_t t[PRIQ_SEQ_WAYS];
+	unsigned nt = 0;
+
+	for(unsigned i = 0; i < l->nruns; ++i)
+		if(_priq_run_size(l->runs + i))
+			t[nt++] = i;
+
+	for(unsigned i = nt / 2; i-- > 0;)
+		_priq_seq_tsift_down(l, t, nt, i, cmp);
+
+	uint64_t n = 0;
+	while(n < limit && nt)
+	{
+		struct _PriqRun* r = l->runs + t[0];
+
+		if(from)
+			from[n] = t[0];
+		out[n++] = r->data[r->head++];
+
+		if(!_priq_run_size(r))
+			t[0] = t[--nt];
+		if(nt)
+			_priq_seq_tsift_down(l, t, nt, 0, cmp);
+	}
+
+	return n;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Puts the buffered elements of a level back into their runs and frees
+ * exhausted runs. Needed before the runs of a level change.
+ * Complexity O(PRIQ_SEQ_BUFFER + PRIQ_SEQ_WAYS)
+ */
+static void _priq_seq_rewind(struct _PriqLevel* l)
+{
+	// the buffer is consumed from the front, so the rest of every run
+	// in it is the last part taken from that run
+	for(unsigned i = l->bhead; i < l->bend; ++i)
+		l->runs[l->from[i]].head--;
+
+	l->bhead = 0;
+	l->bend = 0;
+
+	unsigned n = 0;
+	for(unsigned i = 0; i < l->nruns; ++i)
+	{
+		if(_priq_run_size(l->runs + i))
+			l->runs[n++] = l->runs[i];
+		else
+			free(l->runs[i].data);
+	}
+	l->nruns = n;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Refills an empty level buffer.
+ * Complexity O(PRIQ_SEQ_BUFFER log PRIQ_SEQ_WAYS)
+ */
+static inline void _priq_seq_refill(struct _PriqLevel* l, Pricmp cmp)
+{
+	if(l->bhead < l->bend || !l->nruns)
+		return;
+
+	_priq_seq_rewind(l);
+	l->bend = _priq_seq_kmerge(l, l->buf, l->from, PRIQ_SEQ_BUFFER, cmp);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of elements in a level.
+ */
+static uint64_t _priq_seq_level_size(struct _PriqLevel* l)
+{
+	uint64_t n = l->bend - l->bhead;
+	for(unsigned i = 0; i < l->nruns; ++i)
+		n += _priq_run_size(l->runs + i);
+	return n;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Merges all runs of a full level into one run of the next level.
+ * Complexity O(m log PRIQ_SEQ_WAYS), m elements in the level
+ */
+static void _priq_seq_push_down(PriqSeq* s, unsigned lv, Pricmp cmp)
+{
+	struct _PriqLevel* l = s->levels[lv];
+
+	_priq_seq_rewind(l);
+
+	struct _PriqRun run;
+	run.end = _priq_seq_level_size(l);
+	run.head = 0;
+	run.data = _priq_seq_malloc(run.end * sizeof(cp));
+
+	_priq_seq_kmerge(l, run.data, NULL, run.end, cmp);
+	_priq_seq_rewind(l);
+
+	_priq_seq_add_run(s, lv + 1, run, cmp);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Adds a sorted run to a level. A full level is pushed down first.
+ */
+static void _priq_seq_add_run(PriqSeq* s, unsigned lv, struct _PriqRun run, Pricmp cmp)
+{
+	if(lv >= PRIQ_SEQ_LEVELS)
+		abort();
+
+	while(lv >= s->nlevels)
+	{
+		struct _PriqLevel* l = _priq_seq_malloc(sizeof(*l));
+		l->nruns = 0;
+		l->bhead = 0;
+		l->bend = 0;
+		s->levels[s->nlevels++] = l;
+	}
+
+	struct _PriqLevel* l = s->levels[lv];
+
+	_priq_seq_rewind(l);
+
+	if(l->nruns == PRIQ_SEQ_WAYS)
+		_priq_seq_push_down(s, lv, cmp);
+
+	l->runs[l->nruns++] = run;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Cuts k evenly spread elements out of a run with more than k elements.
+ * Both the rest of the run and the returned run stay sorted.
+ * Complexity always O(m), m elements in the run
+ */
+static struct _PriqRun _priq_seq_cut_run(struct _PriqRun* r, uint64_t k)
+{
+	uint64_t m = _priq_run_size(r);
+	uint64_t keep = r->head;
+
+	struct _PriqRun res;
+	res.head = 0;
+	res.end = 0;
+	res.data = _priq_seq_malloc(k * sizeof(cp));
+
+	for(uint64_t i = 0; i < m; ++i)
+	{
+		cp c = r->data[r->head + i];
+
+		// element i goes whenever i * k / m reaches the next integer
+		if((i + 1) * k / m > i * k / m)
+			res.data[res.end++] = c;
+		else
+			r->data[keep++] = c;
+	}
+	r->end = keep;
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Sorts the full insertion heap into a run of level 0.
+ * Complexity O(PRIQ_SEQ_INSERT log PRIQ_SEQ_INSERT)
+ */
+static void _priq_seq_flush(PriqSeq* s, Pricmp cmp)
+{
+	struct _PriqRun run;
+	run.head = 0;
+	run.end = s->nins;
+	run.data = _priq_seq_malloc(run.end * sizeof(cp));
+
+	for(uint64_t i = 0; i < run.end; ++i)
+	{
+		run.data[i] = s->ins[0];
+		s->ins[0] = s->ins[--s->nins];
+		_priq_seq_sift_down(s->ins, s->nins, 0, cmp);
+	}
+
+	_priq_seq_add_run(s, 0, run, cmp);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Finds the smallest element.
+ * Returns -1 for the insertion heap, the level index, or -2 if empty.
+ * Complexity O(levels), amortized refills
+ */
+static int _priq_seq_min(PriqSeq* s, Pricmp cmp)
+{
+	int res = -2;
+	cp min = NULL;
+
+	if(s->nins)
+	{
+		res = -1;
+		min = s->ins[0];
+	}
+
+	for(unsigned i = 0; i < s->nlevels; ++i)
+	{
+		struct _PriqLevel* l = s->levels[i];
+		_priq_seq_refill(l, cmp);
+
+		if(l->bhead < l->bend && (res == -2 || cmp(l->buf[l->bhead], min) < 0))
+		{
+			res = i;
+			min = l->buf[l->bhead];
+		}
+	}
+
+	return res;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS EXTERN
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates an empty sequence heap.
+ * Complexity always O(1)
+ */
+PriqSeq* _priq_seq_create(void)
+{
+	PriqSeq* s = _priq_seq_malloc(sizeof(*s));
+	s->nins = 0;
+	s->nlevels = 0;
+	return s;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys a sequence heap, ff is used on every element unless NULL.
+ * Complexity always O(n)
+ */
+void _priq_seq_destroy(PriqSeq* s, Freefunc ff)
+{
+	for(unsigned i = 0; i < s->nlevels; ++i)
+	{
+		struct _PriqLevel* l = s->levels[i];
+
+		for(unsigned j = l->bhead; ff && j < l->bend; ++j)
+			ff(l->buf[j]);
+
+		for(unsigned j = 0; j < l->nruns; ++j)
+		{
+			for(uint64_t k = l->runs[j].head; ff && k < l->runs[j].end; ++k)
+				ff(l->runs[j].data[k]);
+			free(l->runs[j].data);
+		}
+		free(l);
+	}
+
+	for(unsigned i = 0; ff && i < s->nins; ++i)
+		ff(s->ins[i]);
+
+	free(s);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Inserts an element.
+ * Complexity amortized O(log n)
+ */
+void _priq_seq_insert(PriqSeq* s, cp c, Pricmp cmp)
+{
+	if(s->nins == PRIQ_SEQ_INSERT)
+		_priq_seq_flush(s, cmp);
+
+	s->ins[s->nins] = c;
+	_priq_seq_sift_up(s->ins, s->nins++, cmp);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns the smallest element, NULL if empty.
+ * Complexity O(levels), amortized refills
+ */
+cp _priq_seq_peek(PriqSeq* s, Pricmp cmp)
+{
+	int m = _priq_seq_min(s, cmp);
+
+	if(m == -2)
+		return NULL;
+	if(m == -1)
+		return s->ins[0];
+
+	struct _PriqLevel* l = s->levels[m];
+	return l->buf[l->bhead];
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the smallest element, NULL if empty.
+ * Complexity amortized O(log n)
+ */
+cp _priq_seq_delete(PriqSeq* s, Pricmp cmp)
+{
+	int m = _priq_seq_min(s, cmp);
+
+	if(m == -2)
+		return NULL;
+
+	if(m == -1)
+	{
+		cp res = s->ins[0];
+		s->ins[0] = s->ins[--s->nins];
+		_priq_seq_sift_down(s->ins, s->nins, 0, cmp);
+		return res;
+	}
+
+	struct _PriqLevel* l = s->levels[m];
+	return l->buf[l->bhead++];
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves all elements of s2 into s1 and frees s2.
+ * The runs are moved level by level, elements of the insertion heap are
+ * inserted one by one.
+ * Complexity O(n) worst, no run is copied unless a level overflows
+ */
+void _priq_seq_merge(PriqSeq* s1, PriqSeq* s2, Pricmp cmp)
+{
+	for(unsigned i = 0; i < s2->nlevels; ++i)
+	{
+		struct _PriqLevel* l = s2->levels[i];
+		_priq_seq_rewind(l);
+
+		for(unsigned j = 0; j < l->nruns; ++j)
+			_priq_seq_add_run(s1, i, l->runs[j], cmp);
+
+		free(l);
+	}
+
+	for(unsigned i = 0; i < s2->nins; ++i)
+		_priq_seq_insert(s1, s2->ins[i], cmp);
+
+	free(s2);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves half of the elements of s into out. Whole runs are moved, the
+ * biggest levels first, until the next run holds more than still needed.
+ * That run gives the rest (see _priq_seq_cut_run). The insertion heap
+ * gives its back part last, the front part stays a valid heap.
+ * Returns the number of moved elements.
+ * Complexity O(n) worst, for the cut run and the levels out pushes down
+ */
+uint64_t _priq_seq_split(PriqSeq* s, PriqSeq* out, Pricmp cmp)
+{
+	uint64_t half = s->nins;
+	for(unsigned i = 0; i < s->nlevels; ++i)
+		half += _priq_seq_level_size(s->levels[i]);
+	half /= 2;
+
+	uint64_t need = half;
+
+	for(unsigned i = s->nlevels; i-- > 0 && need;)
+	{
+		struct _PriqLevel* l = s->levels[i];
+		_priq_seq_rewind(l);
+
+		for(unsigned j = 0; j < l->nruns && need;)
+		{
+			uint64_t m = _priq_run_size(l->runs + j);
+
+			if(m <= need)
+			{
+				_priq_seq_add_run(out, i, l->runs[j], cmp);
+				l->runs[j] = l->runs[--l->nruns];
+				need -= m;
+			}
+			else
+			{
+				_priq_seq_add_run(out, i, _priq_seq_cut_run(l->runs + j, need), cmp);
+				need = 0;
+			}
+		}
+	}
+
+	uint64_t m = need < s->nins ? need : s->nins;
+	for(unsigned i = s->nins - m; i < s->nins; ++i)
+		_priq_seq_insert(out, s->ins[i], cmp);
+	s->nins -= m;
+
+	return half - need + m;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes all elements for which pred is true. Runs are compacted in
+ * place and stay sorted, the insertion heap is rebuilt bottom up.
+ * Returns the number of removed elements.
+ * Complexity always O(n)
+ */
+uint64_t _priq_seq_remove_if(PriqSeq* s, Pripred pred, Freefunc ff, Pricmp cmp)
+{
+	uint64_t removed = 0;
+
+	for(unsigned i = 0; i < s->nlevels; ++i)
+	{
+		struct _PriqLevel* l = s->levels[i];
+		_priq_seq_rewind(l);
+
+		for(unsigned j = 0; j < l->nruns; ++j)
+		{
+			struct _PriqRun* r = l->runs + j;
+			uint64_t w = r->head;
+
+			for(uint64_t k = r->head; k < r->end; ++k)
+			{
+				if(!pred(r->data[k]))
+					r->data[w++] = r->data[k];
+				else if(ff)
+					ff(r->data[k]);
+			}
+
+			removed += r->end - w;
+			r->end = w;
+		}
+
+		// frees the emptied runs
+		_priq_seq_rewind(l);
+	}
+
+	unsigned n = 0;
+	for(unsigned i = 0; i < s->nins; ++i)
+	{
+		if(!pred(s->ins[i]))
+			s->ins[n++] = s->ins[i];
+		else if(ff)
+			ff(s->ins[i]);
+	}
+	removed += s->nins - n;
+	s->nins = n;
+
+	for(unsigned i = n / 2; i-- > 0;)
+		_priq_seq_sift_down(s->ins, n, i, cmp);
+
+	return removed;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Sequence heap invariant: heap order of the insertion heap, sorted runs
+ * and buffers, and the element count.
+ * Complexity always O(n)
+ * @return If NULL -> Ok. Else an error msg.
+ */
+const char* _priq_seq_invariant(PriqSeq* s, Pricmp cmp, uint64_t size)
+{
+	uint64_t n = s->nins;
+
+	for(unsigned i = 1; i < s->nins; ++i)
+		if(cmp(s->ins[(i - 1) / 2], s->ins[i]) > 0)
+			return "WRONG STRUCTURE: insertion heap order failed";
+
+	for(unsigned i = 0; i < s->nlevels; ++i)
+	{
+		struct _PriqLevel* l = s->levels[i];
+
+		for(unsigned j = l->bhead + 1; j < l->bend; ++j)
+			if(cmp(l->buf[j - 1], l->buf[j]) > 0)
+				return "WRONG STRUCTURE: level buffer not sorted";
+
+		for(unsigned j = 0; j < l->nruns; ++j)
+		{
+			struct _PriqRun* r = l->runs + j;
+			for(uint64_t k = r->head + 1; k < r->end; ++k)
+				if(cmp(r->data[k - 1], r->data[k]) > 0)
+					return "WRONG STRUCTURE: run not sorted";
+
+			if(l->bhead < l->bend && r->head < r->end
+				&& cmp(l->buf[l->bend - 1], r->data[r->head]) > 0)
+				return "WRONG STRUCTURE: level buffer not smaller than runs";
+		}
+
+		n += _priq_seq_level_size(l);
+	}
+
+	if(n != size)
+		return "WRONG STRUCTURE: size != real #contend";
+
+	return NULL;
+}
@@ -0,0 +1,85 @@
+/**
+ * Sequence heap backend of priq (internal, see PRIQ_BACKEND_SEQUENCE).
+ *
+ * After P. Sanders, "Fast priority queues for cached memory".
+ * New elements go into a small insertion heap. A full insertion heap is
+ * sorted into a run. Runs are collected in levels of up to PRIQ_SEQ_WAYS
+ * runs, a full level is k-way merged into one run of the next level.
+ * Every level has a buffer with its smallest elements, refilled by
+ * k-way merging its runs. All accesses to runs are sequential.
+ */
+
+#ifndef _PRIQ_SEQ_H_
+#define _PRIQ_SEQ_H_
+
+#include "priq.h"
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+// Insertion heap capacity, also the length of the runs of level 0
+#ifndef PRIQ_SEQ_INSERT
+	#define PRIQ_SEQ_INSERT 1024
+#endif
+
+// Runs per level (k of the k-way merge)
+#ifndef PRIQ_SEQ_WAYS
+	#define PRIQ_SEQ_WAYS 16
+#endif
+
+// Level buffer size
+#ifndef PRIQ_SEQ_BUFFER
+	#define PRIQ_SEQ_BUFFER 256
+#endif
+
+// Maximum number of levels, level i holds runs of about
+// PRIQ_SEQ_INSERT * PRIQ_SEQ_WAYS^i elements
+#define PRIQ_SEQ_LEVELS 16
+
+// Sorted sequence, data[head..end) are the remaining elements
+struct _PriqRun
+{
+	cp* data;
+	uint64_t head;
+	uint64_t end;
+};
+
+struct _PriqLevel
+{
+	struct _PriqRun runs[PRIQ_SEQ_WAYS];
+	unsigned nruns;
+	/** buf[bhead..bend) are the smallest elements of the runs */
+	cp buf[PRIQ_SEQ_BUFFER];
+	/** Run each buffered element was taken from */
+	uint8_t from[PRIQ_SEQ_BUFFER];
+	unsigned bhead;
+	unsigned bend;
+};
+
+struct _PriqSeq
+{
+	/** Insertion heap, binary heap in an array */
+	cp ins[PRIQ_SEQ_INSERT];
+	unsigned nins;
+	struct _PriqLevel* levels[PRIQ_SEQ_LEVELS];
+	unsigned nlevels;
+};
+
+typedef struct _PriqSeq PriqSeq;
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// INTERFACE (intern, sizes are kept by the Priq)
+
+PriqSeq* _priq_seq_create(void);
+void _priq_seq_destroy(PriqSeq* s, Freefunc ff);
+void _priq_seq_insert(PriqSeq* s, cp c, Pricmp cmp);
+cp _priq_seq_peek(PriqSeq* s, Pricmp cmp);
+cp _priq_seq_delete(PriqSeq* s, Pricmp cmp);
+void _priq_seq_merge(PriqSeq* s1, PriqSeq* s2, Pricmp cmp);
+uint64_t _priq_seq_split(PriqSeq* s, PriqSeq* out, Pricmp cmp);
+uint64_t _priq_seq_remove_if(PriqSeq* s, Pripred pred, Freefunc ff, Pricmp cmp);
+const char* _priq_seq_invariant(PriqSeq* s, Pricmp cmp, uint64_t size);
+
+#endif
@@ -0,0 +1,549 @@
+/**
+ * Multi process priority queue in a POSIX shared memory segment.
+ */
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// HEADER
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "priq_shm.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+// "priqshm" and layout version 1, written last by priq_shm_create
+#define PRIQ_SHM_MAGIC 0x7072697173686d01ULL
+
+// Node in the segment, followed by its record. Links are segment offsets,
+// 0 is none (the segment header is at offset 0)
+struct _PriqShmNode
+{
+	uint64_t left;
+	uint64_t right;
+	/** Set while the node holds a queued record, see _priq_shm_recover */
+	uint64_t live;
+	unsigned char record[];
+};
+
+// Start of the segment
+struct _PriqShmSegment
+{
+	uint64_t magic;
+	uint32_t record_size;
+	uint32_t stride;
+	uint64_t capacity;
+	/** Offset of the first node */
+	uint64_t nodes;
+	uint64_t size;
+	uint64_t top;
+	/** Released nodes, linked by right */
+	uint64_t free;
+	/** Nodes handed out so far, the rest were never touched */
+	uint64_t used;
+	pthread_mutex_t lock;
+};
+
+struct _PriqShm
+{
+	struct _PriqShmSegment* seg;
+	char* base;
+	uint64_t len;
+	Pricmp cmp;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS INTERN
+
+#define _priq_shm_node(q, off) ((struct _PriqShmNode*)((q)->base + (off)))
+#define _priq_shm_record(q, off) ((cp)_priq_shm_node(q, off)->record)
+#define _priq_shm_nth(seg, i) ((seg)->nodes + (uint64_t)(i) * (seg)->stride)
+
+// -----------------------------------------------------------------------------
+/**
+ * Commit point of enqueue and dequeue. The flag is written before any
+ * later change of the heap, so a recovery sees the operation either
+ * done or not.
+ */
+static inline void _priq_shm_mark(struct _PriqShmNode* n, uint64_t live)
+{
+	__atomic_store_n(&n->live, live, __ATOMIC_RELEASE);
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Segment size for the given capacity, 0 on overflow.
+ */
+static uint64_t _priq_shm_length(uint64_t nodes, uint32_t stride, uint64_t capacity)
+{
+	if(capacity > (UINT64_MAX - nodes) / stride)
+		return 0;
+	return nodes + capacity * stride;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Maps a segment, the descriptor is closed. Returns NULL on failure.
+ */
+static PriqShm _priq_shm_map(int fd, uint64_t len, Pricmp cmp)
+{
+	void* base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if(base == MAP_FAILED)
+		return NULL;
+
+	PriqShm q = malloc(sizeof(*q));
+	if(!q)
+		abort();
+
+	q->seg = base;
+	q->base = base;
+	q->len = len;
+	q->cmp = cmp;
+	return q;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Merges two heaps given by offsets, like _priq_heap_merge.
+ * Complexity O(log n)
+ */
+static uint64_t _priq_shm_merge(PriqShm q, uint64_t h1, uint64_t h2)
+{
+	if(!h1)
+		return h2;
+
+	if(!h2)
+		return h1;
+
+	if(q->cmp(_priq_shm_record(q, h1), _priq_shm_record(q, h2)) > 0)
+	{
+		uint64_t t = h1;
+		h1 = h2;
+		h2 = t;
+	}
+
+	struct _PriqShmNode* n = _priq_shm_node(q, h1);
+	h2 = _priq_shm_merge(q, n->left, h2);
+
+	// care for balance
+	n->left = n->right;
+	n->right = h2;
+
+	return h1;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Rebuilds the heap and the free list after a process died holding the
+ * lock. Every live node goes into the heap, merged pairwise round by
+ * round, every other handed out node into the free list.
+ * Complexity O(n)
+ */
+static void _priq_shm_recover(PriqShm q)
+{
+	struct _PriqShmSegment* seg = q->seg;
+	uint64_t* keep = malloc((seg->used ? seg->used : 1) * sizeof(*keep));
+	uint64_t n = 0;
+
+	if(!keep)
+		abort();
+
+	seg->free = 0;
+	for(uint64_t i = seg->used; i-- > 0;)
+	{
+		uint64_t off = _priq_shm_nth(seg, i);
+		struct _PriqShmNode* node = _priq_shm_node(q, off);
+
+		node->left = 0;
+		node->right = 0;
+
+		if(node->live)
+		{
+			keep[n++] = off;
+		}
+		else
+		{
+			node->right = seg->free;
+			seg->free = off;
+		}
+	}
+
+	uint64_t r = 0;
+	uint64_t w = n;
+	for(uint64_t i = 1; i < n; ++i)
+	{
+		uint64_t a = keep[r++ % n];
+		uint64_t b = keep[r++ % n];
+		keep[w++ % n] = _priq_shm_merge(q, a, b);
+	}
+
+	seg->top = n ? keep[r % n] : 0;
+	seg->size = n;
+
+	free(keep);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Takes the queue lock, recovers the queue if its last owner died.
+ * Returns false with errno set if the lock is unusable, ENOTRECOVERABLE
+ * once a process died during the recovery itself.
+ */
+static bool _priq_shm_lock(PriqShm q)
+{
+	int rc = pthread_mutex_lock(&q->seg->lock);
+
+	if(rc == EOWNERDEAD)
+	{
+		_priq_shm_recover(q);
+		pthread_mutex_consistent(&q->seg->lock);
+		return true;
+	}
+
+	if(rc)
+		errno = rc;
+
+	return rc == 0;
+}
+
+#define _priq_shm_unlock(q) pthread_mutex_unlock(&(q)->seg->lock)
+
+// -----------------------------------------------------------------------------
+/**
+ * Invariant helper: heap order below h, counts the live nodes.
+ */
+static bool _priq_shm_heap_inv(PriqShm q, uint64_t h, uint64_t* n)
+{
+	struct _PriqShmSegment* seg = q->seg;
+
+	if(!h)
+		return true;
+
+	if(h < seg->nodes || h >= q->len || (h - seg->nodes) % seg->stride)
+		return false;
+
+	struct _PriqShmNode* node = _priq_shm_node(q, h);
+	if(!node->live || ++*n > seg->size)
+		return false;
+
+	if(node->left && q->cmp(node->record, _priq_shm_record(q, node->left)) > 0)
+		return false;
+
+	if(node->right && q->cmp(node->record, _priq_shm_record(q, node->right)) > 0)
+		return false;
+
+	return _priq_shm_heap_inv(q, node->left, n) && _priq_shm_heap_inv(q, node->right, n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a shared queue in a new segment.
+ * Returns NULL if the segment exists or can't be created.
+ * Complexity always O(1)
+ */
+PriqShm priq_shm_create(const char* name, uint32_t record_size, uint64_t capacity,
+	Pricmp cmp)
+{
+	if(!record_size || !capacity || record_size > UINT32_MAX / 2)
+		return NULL;
+
+	uint64_t nodes = (sizeof(struct _PriqShmSegment) + 63) & ~(uint64_t)63;
+	uint32_t stride = sizeof(struct _PriqShmNode) + ((record_size + 7) & ~7u);
+	uint64_t len = _priq_shm_length(nodes, stride, capacity);
+	if(!len)
+		return NULL;
+
+	int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if(fd < 0)
+		return NULL;
+
+	if(ftruncate(fd, len) != 0)
+	{
+		close(fd);
+		shm_unlink(name);
+		return NULL;
+	}
+
+	PriqShm q = _priq_shm_map(fd, len, cmp);
+	if(!q)
+	{
+		shm_unlink(name);
+		return NULL;
+	}
+
+	struct _PriqShmSegment* seg = q->seg;
+	seg->record_size = record_size;
+	seg->stride = stride;
+	seg->capacity = capacity;
+	seg->nodes = nodes;
+	seg->size = 0;
+	seg->top = 0;
+	seg->free = 0;
+	seg->used = 0;
+
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	int rc = pthread_mutex_init(&seg->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+
+	if(rc != 0)
+	{
+		priq_shm_close(q);
+		shm_unlink(name);
+		return NULL;
+	}
+
+	// ready for priq_shm_open
+	__atomic_store_n(&seg->magic, PRIQ_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	return q;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Opens an existing shared queue.
+ * Returns NULL if there is none or it is not ready yet.
+ * Complexity always O(1)
+ */
+PriqShm priq_shm_open(const char* name, Pricmp cmp)
+{
+	int fd = shm_open(name, O_RDWR, 0);
+	if(fd < 0)
+		return NULL;
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(struct _PriqShmSegment))
+	{
+		close(fd);
+		return NULL;
+	}
+
+	PriqShm q = _priq_shm_map(fd, st.st_size, cmp);
+	if(!q)
+		return NULL;
+
+	struct _PriqShmSegment* seg = q->seg;
+	if(__atomic_load_n(&seg->magic, __ATOMIC_ACQUIRE) != PRIQ_SHM_MAGIC
+		|| _priq_shm_length(seg->nodes, seg->stride, seg->capacity) != q->len)
+	{
+		priq_shm_close(q);
+		return NULL;
+	}
+
+	return q;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Closes the handle. The queue stays in the segment.
+ * Complexity always O(1)
+ */
+void priq_shm_close(PriqShm q)
+{
+	munmap(q->base, q->len);
+	free(q);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes a segment.
+ */
+int priq_shm_unlink(const char* name)
+{
+	return shm_unlink(name);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Copies a record into the queue. Returns false if the queue is full
+ * (errno ENOSPC) or the lock is unusable.
+ * Complexity O(log n)
+ */
+bool priq_shm_enqueue(PriqShm q, const void* record)
+{
+	struct _PriqShmSegment* seg = q->seg;
+
+	if(!_priq_shm_lock(q))
+		return false;
+
+	uint64_t off = seg->free;
+	if(off)
+	{
+		seg->free = _priq_shm_node(q, off)->right;
+	}
+	else if(seg->used < seg->capacity)
+	{
+		off = _priq_shm_nth(seg, seg->used++);
+	}
+	else
+	{
+		_priq_shm_unlock(q);
+		errno = ENOSPC;
+		return false;
+	}
+
+	struct _PriqShmNode* n = _priq_shm_node(q, off);
+	n->left = 0;
+	n->right = 0;
+	memcpy(n->record, record, seg->record_size);
+	_priq_shm_mark(n, 1);
+
+	seg->top = _priq_shm_merge(q, seg->top, off);
+	seg->size++;
+
+	_priq_shm_unlock(q);
+	return true;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes the record with the lowest priority and copies it to record.
+ * Returns false if the queue is empty (errno ENOMSG) or the lock is
+ * unusable.
+ * Complexity O(log n)
+ */
+bool priq_shm_dequeue(PriqShm q, void* record)
+{
+	struct _PriqShmSegment* seg = q->seg;
+
+	if(!_priq_shm_lock(q))
+		return false;
+
+	uint64_t off = seg->top;
+	if(!off)
+	{
+		_priq_shm_unlock(q);
+		errno = ENOMSG;
+		return false;
+	}
+
+	struct _PriqShmNode* n = _priq_shm_node(q, off);
+	memcpy(record, n->record, seg->record_size);
+	_priq_shm_mark(n, 0);
+
+	seg->top = _priq_shm_merge(q, n->right, n->left);
+	seg->size--;
+
+	n->left = 0;
+	n->right = seg->free;
+	seg->free = off;
+
+	_priq_shm_unlock(q);
+	return true;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Copies the record with the lowest priority to record.
+ * Returns false if the queue is empty (errno ENOMSG) or the lock is
+ * unusable.
+ * Complexity always O(1)
+ */
+bool priq_shm_peek(PriqShm q, void* record)
+{
+	struct _PriqShmSegment* seg = q->seg;
+
+	if(!_priq_shm_lock(q))
+		return false;
+
+	bool res = seg->top != 0;
+	if(res)
+		memcpy(record, _priq_shm_node(q, seg->top)->record, seg->record_size);
+	else
+		errno = ENOMSG;
+
+	_priq_shm_unlock(q);
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns the number of records in the queue, 0 if the lock is unusable.
+ * Complexity always O(1)
+ */
+uint64_t priq_shm_size(PriqShm q)
+{
+	if(!_priq_shm_lock(q))
+		return 0;
+
+	uint64_t res = q->seg->size;
+
+	_priq_shm_unlock(q);
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns the record size of the queue.
+ * Complexity always O(1)
+ */
+uint32_t priq_shm_record_size(PriqShm q)
+{
+	return q->seg->record_size;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Shared queue invariant check: heap order, live nodes in the heap,
+ * free list plus heap are all handed out nodes.
+ * Complexity always O(n)
+ * @return If NULL -> Ok. Else an error msg.
+ */
+const char* priq_shm_invariant(PriqShm q)
+{
+	struct _PriqShmSegment* seg = q->seg;
+	const char* res = NULL;
+	uint64_t n = 0;
+
+	if(!_priq_shm_lock(q))
+		return "WRONG STRUCTURE: lock not recoverable";
+
+	uint64_t nfree = 0;
+	for(uint64_t f = seg->free; f && nfree <= seg->used; f = _priq_shm_node(q, f)->right)
+	{
+		if(_priq_shm_node(q, f)->live)
+			break;
+		nfree++;
+	}
+
+	if(seg->used > seg->capacity)
+		res = "WRONG STRUCTURE: more nodes used than capacity";
+	else if(!_priq_shm_heap_inv(q, seg->top, &n))
+		res = "WRONG STRUCTURE: heap invariant failed";
+	else if(n != seg->size)
+		res = "WRONG STRUCTURE: size != real #contend";
+	else if(nfree + n != seg->used)
+		res = "WRONG STRUCTURE: lost nodes";
+
+	_priq_shm_unlock(q);
+	return res;
+}
@@ -0,0 +1,138 @@
+/**
+ * Multi process priority queue in a POSIX shared memory segment.
+ *
+ * The queue is a skew heap like the one of priq, but everything lives in
+ * the segment: nodes are addressed by their offset in the segment, and
+ * every node holds a fixed size record instead of a pointer. Any process
+ * that opens the segment can enqueue and dequeue, records are copied in
+ * and out under a robust process shared mutex.
+ *
+ * If a process dies while holding the lock, the next one to take it
+ * rebuilds the heap from the nodes marked live. An interrupted enqueue or
+ * dequeue is then either done completely or not at all. Only a process
+ * dying during that recovery leaves the lock unusable: every operation
+ * fails from then on with errno ENOTRECOVERABLE, see priq_shm_enqueue.
+ *
+ * The segment has a fixed capacity, it never grows. Link with -lrt on
+ * older C libraries.
+ */
+
+#ifndef _PRIQ_SHM_H_
+#define _PRIQ_SHM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "priq.h"
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+// Process local handle of a shared queue (opaque)
+typedef struct _PriqShm* PriqShm;
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// INTERFACE
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a shared queue in a new segment called name (see shm_open) for
+ * up to capacity records of record_size bytes each.
+ * cmp works like in priq_create, but is called with pointers to records
+ * in the segment. Every process passes its own, they must agree.
+ * Returns NULL if the segment exists or can't be created.
+ * Complexity always O(1)
+ */
+PriqShm priq_shm_create(const char* name, uint32_t record_size, uint64_t capacity,
+	Pricmp cmp);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Opens the existing shared queue name. See priq_shm_create.
+ * Returns NULL if there is none or it is not ready yet.
+ * Complexity always O(1)
+ */
+PriqShm priq_shm_open(const char* name, Pricmp cmp);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Closes the handle. The queue stays in the segment.
+ * Complexity always O(1)
+ */
+void priq_shm_close(PriqShm q);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes the segment name. Open handles stay valid until closed.
+ * Returns 0 on success, -1 otherwise (see shm_unlink).
+ */
+int priq_shm_unlink(const char* name);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Copies a record of the queue's record size into the queue.
+ * Returns false if the queue is full, errno is ENOSPC then. Otherwise
+ * the lock is unusable and errno tells why (see pthread_mutex_lock).
+ * Complexity O(log n)
+ */
+bool priq_shm_enqueue(PriqShm q, const void* record);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes the record with the lowest priority and copies it to record.
+ * Returns false if the queue is empty, errno is ENOMSG then. Otherwise
+ * the lock is unusable, see priq_shm_enqueue.
+ * Complexity O(log n)
+ */
+bool priq_shm_dequeue(PriqShm q, void* record);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Copies the record with the lowest priority to record, without removing
+ * it. Returns false if the queue is empty, errno is ENOMSG then.
+ * Otherwise the lock is unusable, see priq_shm_enqueue.
+ * Complexity always O(1)
+ */
+bool priq_shm_peek(PriqShm q, void* record);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns the number of records in the queue. Returns 0 with errno set
+ * if the lock is unusable, see priq_shm_enqueue.
+ * Complexity always O(1)
+ */
+uint64_t priq_shm_size(PriqShm q);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns the record size of the queue.
+ * Complexity always O(1)
+ */
+uint32_t priq_shm_record_size(PriqShm q);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Shared queue invariant check, takes the lock.
+ * Complexity always O(n)
+ * @return If NULL -> Ok. Else an error msg.
+ */
+const char* priq_shm_invariant(PriqShm q);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,294 @@
+/**
+ * Work stealing priority scheduler on top of priq.
+ */
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// HEADER
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "priq_steal.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+#define PRIQ_WS_CACHE_LINE 64
+
+// One worker, aligned to avoid false sharing between the queue locks
+struct _PriqWorker
+{
+	pthread_mutex_t lock;
+	Priq q;
+	/** Copy of priq_size(q), readable without the lock */
+	uint64_t backlog;
+	PriqWs ws;
+	unsigned index;
+	pthread_t thread;
+} __attribute__((aligned(PRIQ_WS_CACHE_LINE)));
+
+struct _PriqWs
+{
+	struct _PriqWorker* workers;
+	unsigned nworkers;
+	Pricmp cmp;
+	Priqtask run;
+	/** Queued plus running tasks */
+	uint64_t pending;
+	uint64_t steals;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS INTERN
+
+// -----------------------------------------------------------------------------
+/**
+ * Publishes the queue size of a worker. Caller holds the worker lock.
+ */
+static inline void _priq_ws_publish(struct _PriqWorker* w)
+{
+	__atomic_store_n(&w->backlog, priq_size(w->q), __ATOMIC_RELAXED);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Locks two workers in index order, so two thieves can't deadlock.
+ */
+static void _priq_ws_lock2(struct _PriqWorker* a, struct _PriqWorker* b)
+{
+	if(a->index < b->index)
+	{
+		pthread_mutex_lock(&a->lock);
+		pthread_mutex_lock(&b->lock);
+	}
+	else
+	{
+		pthread_mutex_lock(&b->lock);
+		pthread_mutex_lock(&a->lock);
+	}
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves half of the backlog of the busiest other worker into the queue
+ * of self. Returns false if there was nothing to steal.
+ */
+static bool _priq_ws_steal(PriqWs ws, struct _PriqWorker* self)
+{
+	struct _PriqWorker* victim = NULL;
+	uint64_t best = 0;
+
+	for(unsigned i = 1; i < ws->nworkers; ++i)
+	{
+		struct _PriqWorker* w = ws->workers + (self->index + i) % ws->nworkers;
+		uint64_t b = __atomic_load_n(&w->backlog, __ATOMIC_RELAXED);
+		if(b > best)
+		{
+			best = b;
+			victim = w;
+		}
+	}
+
+	if(!victim)
+		return false;
+
+	bool res = false;
+	_priq_ws_lock2(self, victim);
+
+	if(priq_size(victim->q) >= 2)
+	{
+		priq_split(victim->q, self->q);
+		res = true;
+	}
+	else if(priq_size(victim->q) == 1)
+	{
+		priq_enqueue(self->q, priq_dequeue(victim->q));
+		res = true;
+	}
+
+	_priq_ws_publish(victim);
+	_priq_ws_publish(self);
+
+	pthread_mutex_unlock(&victim->lock);
+	pthread_mutex_unlock(&self->lock);
+
+	if(res)
+		__atomic_add_fetch(&ws->steals, 1, __ATOMIC_RELAXED);
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Worker main loop. Runs own tasks first, steals if idle, leaves when
+ * no task is pending anymore.
+ */
+static void* _priq_ws_worker(void* arg)
+{
+	struct _PriqWorker* self = arg;
+	PriqWs ws = self->ws;
+
+	while(__atomic_load_n(&ws->pending, __ATOMIC_ACQUIRE))
+	{
+		pthread_mutex_lock(&self->lock);
+		cp c = priq_dequeue(self->q);
+		_priq_ws_publish(self);
+		pthread_mutex_unlock(&self->lock);
+
+		if(c)
+		{
+			ws->run(ws, self->index, c);
+			__atomic_sub_fetch(&ws->pending, 1, __ATOMIC_ACQ_REL);
+		}
+		else if(!_priq_ws_steal(ws, self))
+		{
+			sched_yield();
+		}
+	}
+
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS EXTERN
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a new scheduler with the given number of workers.
+ * Returns NULL if workers is 0.
+ */
+PriqWs priq_ws_create(unsigned workers, Pricmp cmp, Priqtask run)
+{
+	if(!workers)
+		return NULL;
+
+	PriqWs ws = malloc(sizeof(*ws));
+	void* mem = NULL;
+	if(!ws || posix_memalign(&mem, PRIQ_WS_CACHE_LINE, workers * sizeof(*ws->workers)))
+		abort();
+
+	ws->workers = mem;
+	ws->nworkers = workers;
+	ws->cmp = cmp;
+	ws->run = run;
+	ws->pending = 0;
+	ws->steals = 0;
+
+	for(unsigned i = 0; i < workers; ++i)
+	{
+		struct _PriqWorker* w = ws->workers + i;
+		pthread_mutex_init(&w->lock, NULL);
+		w->q = priq_create(cmp);
+		w->backlog = 0;
+		w->ws = ws;
+		w->index = i;
+	}
+
+	return ws;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys a scheduler. Tasks that are still queued are released with
+ * Freefunc unless it is NULL.
+ */
+void priq_ws_destroy(PriqWs ws, Freefunc ff)
+{
+	for(unsigned i = 0; i < ws->nworkers; ++i)
+	{
+		priq_destroy(ws->workers[i].q, ff);
+		pthread_mutex_destroy(&ws->workers[i].lock);
+	}
+
+	free(ws->workers);
+	free(ws);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Submits a task to the queue of the given worker.
+ * Complexity O(log n)
+ */
+void priq_ws_submit(PriqWs ws, unsigned worker, cp c)
+{
+	struct _PriqWorker* w = ws->workers + worker % ws->nworkers;
+
+	// count first, a running parent task keeps pending > 0 until here
+	__atomic_add_fetch(&ws->pending, 1, __ATOMIC_ACQ_REL);
+
+	pthread_mutex_lock(&w->lock);
+	priq_enqueue(w->q, c);
+	_priq_ws_publish(w);
+	pthread_mutex_unlock(&w->lock);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Merges a whole queue into the queue of the given worker.
+ * Complexity O(log n)
+ */
+bool priq_ws_submit_all(PriqWs ws, unsigned worker, Priq q)
+{
+	struct _PriqWorker* w = ws->workers + worker % ws->nworkers;
+
+	// the worker queues are skew heaps, priq_merge refuses other backends
+	if(q->cmp != ws->cmp || q->backend != PRIQ_BACKEND_SKEW)
+		return false;
+
+	__atomic_add_fetch(&ws->pending, priq_size(q), __ATOMIC_ACQ_REL);
+
+	pthread_mutex_lock(&w->lock);
+	w->q = priq_merge(w->q, q);
+	_priq_ws_publish(w);
+	pthread_mutex_unlock(&w->lock);
+
+	return true;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Starts all workers and blocks until every task is done.
+ */
+bool priq_ws_run(PriqWs ws)
+{
+	unsigned started = 0;
+	bool res = true;
+
+	// worker 0 runs on the calling thread
+	for(started = 1; started < ws->nworkers; ++started)
+	{
+		struct _PriqWorker* w = ws->workers + started;
+		if(pthread_create(&w->thread, NULL, _priq_ws_worker, w))
+		{
+			res = false;
+			break;
+		}
+	}
+
+	_priq_ws_worker(ws->workers);
+
+	for(unsigned i = 1; i < started; ++i)
+		pthread_join(ws->workers[i].thread, NULL);
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of successful steals since priq_ws_create.
+ */
+uint64_t priq_ws_steals(PriqWs ws)
+{
+	return __atomic_load_n(&ws->steals, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,92 @@
+/**
+ * Work stealing priority scheduler on top of priq.
+ *
+ * Every worker owns a Priq and always runs its own most urgent task.
+ * Idle workers steal half of the backlog of another worker with
+ * priq_split. Whole queues can be handed over with priq_ws_submit_all,
+ * which uses priq_merge.
+ */
+
+#ifndef _PRIQ_STEAL_H_
+#define _PRIQ_STEAL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "priq.h"
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+// Scheduler base structure (opaque)
+typedef struct _PriqWs* PriqWs;
+
+// Task function. Called for every task, worker is the index of the
+// running worker. Use it with priq_ws_submit to spawn new tasks.
+typedef void(*Priqtask)(PriqWs ws, unsigned worker, cp c);
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// INTERFACE
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a new scheduler with the given number of workers.
+ * cmp orders the tasks like in priq_create, run executes them.
+ * Returns NULL if workers is 0.
+ */
+PriqWs priq_ws_create(unsigned workers, Pricmp cmp, Priqtask run);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys a scheduler. Tasks that are still queued are released with
+ * Freefunc unless it is NULL.
+ */
+void priq_ws_destroy(PriqWs ws, Freefunc ff);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Submits a task to the queue of the given worker.
+ * Thread safe, may be called from inside a task.
+ * Complexity O(log n)
+ */
+void priq_ws_submit(PriqWs ws, unsigned worker, cp c);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Merges a whole queue into the queue of the given worker.
+ * Don't use q after the call of this function.
+ * Returns false if q has a different comparison function or is not a
+ * PRIQ_BACKEND_SKEW queue, q is untouched then.
+ * Complexity O(log n)
+ */
+bool priq_ws_submit_all(PriqWs ws, unsigned worker, Priq q);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Starts all workers and blocks until every task (including the ones
+ * spawned while running) is done. Can be called again after new submits.
+ * Returns false if not every worker thread could be started, the
+ * started ones still finish all tasks then.
+ */
+bool priq_ws_run(PriqWs ws);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of successful steals since priq_ws_create.
+ */
+uint64_t priq_ws_steals(PriqWs ws);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
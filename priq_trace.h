@@ -0,0 +1,86 @@
+/**
+ * Operation trace of priq, see priq-replay.
+ *
+ * Build libpriq with PRIQ_TRACE (make OPTS=-DPRIQ_TRACE) and every queue
+ * operation is appended to the file named by the environment variable
+ * PRIQ_TRACE_FILE (default "priq.trace"). Every thread collects records in
+ * its own buffer, no lock is taken. Buffers are written when full, when
+ * the thread ends, at exit, or by priq_trace_flush.
+ *
+ * priq_remove_if and elements skipped in tombstone mode are not traced.
+ *
+ * Without PRIQ_TRACE the functions below do nothing.
+ */
+
+#ifndef _PRIQ_TRACE_H_
+#define _PRIQ_TRACE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "priq.h"
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+// Traced operations
+enum
+{
+	PRIQ_OP_CREATE = 1,
+	PRIQ_OP_DESTROY,
+	PRIQ_OP_ENQUEUE,
+	PRIQ_OP_DEQUEUE,
+	PRIQ_OP_MERGE,
+	PRIQ_OP_SPLIT,
+	PRIQ_OP_CLONE,
+	PRIQ_OP_DEQUEUE_MAX,
+};
+
+// One record, stored in host byte order
+struct _PriqTrace
+{
+	/** Global order of the operations. The operation is in the top 8 bit */
+	uint64_t seq;
+	/** The queue (its address while it is alive) */
+	uint64_t queue;
+	/** Element id (its address), or the other queue for merge, split, clone */
+	uint64_t arg;
+	/** Key fingerprint of the element, moved elements for split */
+	uint64_t key;
+};
+
+typedef struct _PriqTrace PriqTrace;
+
+#define PRIQ_TRACE_OP(r) ((unsigned)((r)->seq >> 56))
+#define PRIQ_TRACE_SEQ(r) ((r)->seq & 0x00ffffffffffffffULL)
+
+// Key fingerprint function, see priq_trace_key
+typedef uint64_t(*Prikey)(cp c);
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// INTERFACE
+
+// -----------------------------------------------------------------------------
+/**
+ * Sets the key fingerprint function used for all traced elements.
+ * priq-replay orders elements by it, so it should preserve the order of
+ * the comparison function. Without it the element address is recorded.
+ */
+void priq_trace_key(Prikey k);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Writes the buffered records of the calling thread.
+ */
+void priq_trace_flush(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -4,9 +4,9 @@ TARGET="testcases-dynamic"
 SRC="testcases.c"
 
 ## FLAGS
-CFLAGS="-O2 -std=c99 -pipe -Winline -Wall -Wextra -Werror -Wno-unused"
+CFLAGS="-O2 -std=c99 -pipe -Winline -Wall -Wextra -Werror -Wno-unused -pthread"
 LDFLAGS="-L. -lpriq"
 CC="gcc"
 
-make && $CC $CFLAGS $LDFLAGS -o $TARGET $SRC $LDLIBS && LD_LIBRARY_PATH=$PWD ./$TARGET
+make && $CC $CFLAGS -o $TARGET $SRC $LDFLAGS $LDLIBS && LD_LIBRARY_PATH=$PWD ./$TARGET
 
@@ -0,0 +1,12 @@
+#!/bin/bash
+
+TARGET="testcases-invariant"
+SRC="testcases.c priq.c priq_steal.c priq_seq.c priq_ival.c priq_shm.c"
+
+## FLAGS
+## INVARIANT_SAMPLE=1 runs the full invariant check at every operation
+CFLAGS="-O2 -std=c99 -pipe -Winline -Wall -Wextra -Werror -Wno-unused -pthread -DINVARIANT_CHECKS -DINVARIANT_SAMPLE=${INVARIANT_SAMPLE:-64}"
+LDLIBS="-lrt"
+CC="gcc"
+
+$CC $CFLAGS -o $TARGET $SRC $LDLIBS && ./$TARGET
@@ -4,8 +4,8 @@ TARGET="testcases-static"
 SRC="testcases.c"
 
 ## FLAGS
-CFLAGS="-O2 -std=c99 -pipe -Winline -Wall -Wextra -Werror -Wno-unused"
-LDLIBS="libpriq.a"
+CFLAGS="-O2 -std=c99 -pipe -Winline -Wall -Wextra -Werror -Wno-unused -pthread"
+LDLIBS="libpriq.a -lrt"
 CC="gcc"
 
 make && $CC $CFLAGS -o $TARGET $SRC $LDLIBS && ./$TARGET
@@ -3,14 +3,22 @@
  */
 
 /* ---- System Header ------------------------------------------------------------ */
+#define _POSIX_C_SOURCE 200809L
 #include <time.h>
+#include <errno.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 /* ---- DOT Header --------------------------------------------------------------- */
 #include "priq.h"
+#include "priq_steal.h"
+#include "priq_shm.h"
 
 /* ---- Help funcs & macros ------------------------------------------------------ */
 #define ES_none   "\033[0m"
@@ -368,7 +376,778 @@ void t_08(void)
 	pinfo( "T08: priq_merge massive random test successful" );
 }
 
+void t_09(void)
+{
+	Priq q = priq_create( icompare );
+	Priq out = priq_create( icompare );
+
+	for( uint64_t i = 0; i < 1000; ++i)
+		priq_enqueue( q, a + (rand() % TEST_ARRAY_SIZE));
+
+	if( priq_split( q, out ) != out ) {
+		perr( "T09: priq_split: unexpected result" ); return; }
+
+	if( priq_size( q ) + priq_size( out ) != 1000 || priq_is_empty( out ) ) {
+		perr( "T09: priq_split: sizes %lu + %lu should be 1000.",
+			priq_size( q ), priq_size( out ) ); return; }
+
+	// roughly half, the victim keeps more than its top element
+	if( priq_size( q ) < 250 || priq_size( out ) < 250 ) {
+		perr( "T09: priq_split: sizes %lu + %lu are not balanced.",
+			priq_size( q ), priq_size( out ) ); return; }
+
+	const char* msg = priq_invariant(q);
+	if(!msg)
+		msg = priq_invariant(out);
+	if(msg) {
+		perr( "T09: priq_split: invariant failed: %s", msg ); return; }
+
+	Priq single = priq_create( icompare );
+	priq_enqueue( single, a + 3 );
+	priq_split( single, out );
+	if( priq_size( single ) != 1 ) {
+		perr( "T09: priq_split: single element should stay" ); return; }
+	priq_destroy( single, NULL );
+
+	// into a queue that is not empty
+	for( int k = 0; k < 2; ++k )
+	{
+		Priq src = priq_create_backend( icompare, k ? PRIQ_BACKEND_LEFTIST : PRIQ_BACKEND_SKEW );
+		Priq dst = priq_create_backend( icompare, k ? PRIQ_BACKEND_LEFTIST : PRIQ_BACKEND_SKEW );
+		// the moved part becomes the new top of dst
+		priq_enqueue( src, a + 1 );
+		priq_enqueue( src, a + 2 );
+		priq_enqueue( dst, a + 5 );
+		priq_enqueue( dst, a + 6 );
+
+		priq_split( src, dst );
+		msg = priq_invariant( src );
+		if( !msg )
+			msg = priq_invariant( dst );
+		if( msg || priq_size( src ) != 1 || priq_size( dst ) != 3 ) {
+			perr( "T09: priq_split: into non empty queue: %lu + %lu, %s",
+				priq_size( src ), priq_size( dst ), msg ? msg : "wrong sizes" ); return; }
+
+		priq_destroy( src, NULL );
+		priq_destroy( dst, NULL );
+	}
+
+	// monotone input, the trees are too deep for a subtree of half size
+	for( int k = 0; k < 4; ++k )
+	{
+		Priq src = priq_create_backend( icompare, ( k & 1 ) ? PRIQ_BACKEND_LEFTIST : PRIQ_BACKEND_SKEW );
+		Priq dst = priq_create_backend( icompare, ( k & 1 ) ? PRIQ_BACKEND_LEFTIST : PRIQ_BACKEND_SKEW );
+		for( uint64_t i = 0; i < 10000; ++i )
+			priq_enqueue( src, a + ( ( k & 2 ) ? i : 9999 - i ) );
+
+		priq_split( src, dst );
+		msg = priq_invariant( src );
+		if( !msg )
+			msg = priq_invariant( dst );
+		if( msg || priq_size( src ) < 2500 || priq_size( dst ) < 2500 ) {
+			perr( "T09: priq_split: monotone input: %lu + %lu, %s",
+				priq_size( src ), priq_size( dst ), msg ? msg : "not balanced" ); return; }
+
+		priq_destroy( src, NULL );
+		priq_destroy( dst, NULL );
+	}
+
+	q = priq_merge( q, out );
+
+	uint64_t last = 0;
+	while( !priq_is_empty( q ) )
+	{
+		uint64_t * get = priq_dequeue( q );
+		if( last > *get ) {
+			perr( "T09: priq_split+merge: wrong order" ); return; }
+		last = *get;
+	}
+
+	priq_destroy( q, NULL );
+
+	pinfo( "T09: priq_split test successful" );
+}
+
+#define T10_DEPTH 16
+
+static uint64_t t10_done = 0;
+
+int t10_cmp( void* e1, void* e2 )
+{
+	uintptr_t d1 = (uintptr_t)e1;
+	uintptr_t d2 = (uintptr_t)e2;
+
+	return ( ( d2 >= d1 ) - ( d1 >= d2 ) );
+}
+
+void t10_task( PriqWs ws, unsigned worker, void* c )
+{
+	uintptr_t depth = (uintptr_t)c;
+
+	__atomic_add_fetch( &t10_done, 1, __ATOMIC_RELAXED );
+
+	if( depth > 1 )
+		priq_ws_submit( ws, worker, (void*)(depth - 1) );
+	if( depth > 2 )
+		priq_ws_submit( ws, worker, (void*)(depth - 2) );
+}
+
+void t_10(void)
+{
+	// fibonacci shaped task tree, all seeded on worker 0
+	uint64_t expected[T10_DEPTH + 1] = { 0, 1, 2 };
+	for( int i = 3; i <= T10_DEPTH; ++i )
+		expected[i] = 1 + expected[i - 1] + expected[i - 2];
+
+	PriqWs ws = priq_ws_create( 4, t10_cmp, t10_task );
+
+	priq_ws_submit( ws, 0, (void*)T10_DEPTH );
+
+	if( !priq_ws_run( ws ) ) {
+		perr( "T10: priq_ws_run: could not start workers" ); return; }
+
+	if( t10_done != expected[T10_DEPTH] ) {
+		perr( "T10: priq_ws_run: ran %lu tasks, expected %lu.",
+			t10_done, expected[T10_DEPTH] ); return; }
+
+	// whole queues, the wrong backend is refused
+	t10_done = 0;
+	Priq q = priq_create( t10_cmp );
+	Priq bad = priq_create_backend( t10_cmp, PRIQ_BACKEND_SEQUENCE );
+	priq_enqueue( q, (void*)T10_DEPTH );
+	priq_enqueue( q, (void*)1 );
+	priq_enqueue( bad, (void*)1 );
+
+	if( priq_ws_submit_all( ws, 1, bad ) || priq_size( bad ) != 1 ) {
+		perr( "T10: priq_ws_submit_all: accepted a sequence heap" ); return; }
+	if( !priq_ws_submit_all( ws, 1, q ) ) {
+		perr( "T10: priq_ws_submit_all: refused a skew heap" ); return; }
+
+	if( !priq_ws_run( ws ) || t10_done != expected[T10_DEPTH] + 1 ) {
+		perr( "T10: priq_ws_submit_all: ran %lu tasks, expected %lu.",
+			t10_done, expected[T10_DEPTH] + 1 ); return; }
+
+	priq_destroy( bad, NULL );
+	priq_ws_destroy( ws, NULL );
+
+	pinfo( "T10: priq_ws work stealing test successful" );
+}
+
+#define T11_SIZE 100000
+
+void t_11(void)
+{
+	Priq q = priq_create_backend( icompare, PRIQ_BACKEND_SEQUENCE );
+	Priq out = priq_create_backend( icompare, PRIQ_BACKEND_SEQUENCE );
+
+	Priq skew = priq_create( icompare );
+	if( !q || priq_merge( q, skew ) ) {
+		perr( "T11: priq_create_backend: mixed backends merged" ); return; }
+	priq_destroy( skew, NULL );
+
+	// interleaved, enough to fill several levels
+	for( uint64_t i = 0; i < T11_SIZE; ++i)
+	{
+		priq_enqueue( q, a + (rand() % TEST_ARRAY_SIZE));
+		if( i % 3 == 0 )
+			priq_dequeue( q );
+	}
+
+	const char* msg = priq_invariant(q);
+	if(msg) {
+		perr( "T11: sequence heap: invariant failed: %s", msg ); return; }
+
+	uint64_t total = priq_size( q );
+	priq_split( q, out );
+	if( priq_size( q ) + priq_size( out ) != total || priq_is_empty( out ) ) {
+		perr( "T11: sequence heap: split lost elements" ); return; }
+
+	if( priq_size( out ) != total / 2 ) {
+		perr( "T11: sequence heap: split moved %lu of %lu.",
+			priq_size( out ), total ); return; }
+
+	msg = priq_invariant(q);
+	if(!msg)
+		msg = priq_invariant(out);
+	if(msg) {
+		perr( "T11: sequence heap: invariant failed after split: %s", msg ); return; }
+
+	for( uint64_t i = 0; i < T11_SIZE / 10; ++i)
+		priq_enqueue( out, a + (rand() % TEST_ARRAY_SIZE));
+	total += T11_SIZE / 10;
 
+	q = priq_merge( q, out );
+
+	msg = priq_invariant(q);
+	if(msg) {
+		perr( "T11: sequence heap: invariant failed after merge: %s", msg ); return; }
+
+	uint64_t last = 0;
+	uint64_t n = 0;
+	while( !priq_is_empty( q ) )
+	{
+		uint64_t * peek = priq_peek( q );
+		uint64_t * get = priq_dequeue( q );
+		if( peek != get || last > *get ) {
+			perr( "T11: sequence heap: wrong order" ); return; }
+		last = *get;
+		n++;
+	}
+
+	if( n != total ) {
+		perr( "T11: sequence heap: got %lu elements, expected %lu", n, total ); return; }
+
+	priq_destroy( q, NULL );
+
+	pinfo( "T11: sequence heap backend test successful" );
+}
+
+#define T12_SIZE 2000
+#define T12_CLONES 50
+
+static int u64_sort( const void* e1, const void* e2 )
+{
+	return icompare( *(void**)e1, *(void**)e2 );
+}
+
+void t_12(void)
+{
+	Priq q = priq_create( icompare );
+	Priq clones[T12_CLONES];
+	uint64_t* sorted[T12_SIZE];
+
+	for( uint64_t i = 0; i < T12_SIZE; ++i)
+	{
+		sorted[i] = a + (rand() % TEST_ARRAY_SIZE);
+		priq_enqueue( q, sorted[i] );
+	}
+	qsort( sorted, T12_SIZE, sizeof( *sorted ), u64_sort );
+
+	// every clone is changed on its own, the original must stay intact
+	for( int c = 0; c < T12_CLONES; ++c)
+	{
+		clones[c] = priq_clone( q );
+
+		for( uint64_t i = 0; i < (uint64_t)rand() % 100; ++i)
+			priq_dequeue( clones[c] );
+		for( uint64_t i = 0; i < (uint64_t)rand() % 100; ++i)
+			priq_enqueue( clones[c], a + (rand() % TEST_ARRAY_SIZE));
+		if( c % 2 )
+		{
+			Priq tmp = priq_create( icompare );
+			priq_split( clones[c], tmp );
+			clones[c] = priq_merge( clones[c], tmp );
+		}
+
+		const char* msg = priq_invariant( clones[c] );
+		if(msg) {
+			perr( "T12: priq_clone: invariant failed: %s", msg ); return; }
+	}
+
+	for( int c = 0; c < T12_CLONES; c += 2)
+	{
+		priq_destroy( clones[c], NULL );
+		clones[c] = NULL;
+	}
+
+	for( uint64_t i = 0; i < T12_SIZE; ++i)
+	{
+		uint64_t * deq = priq_dequeue( q );
+		if( !deq || *deq != *sorted[i] ) {
+			perr( "T12: priq_clone: original changed at %lu", i ); return; }
+	}
+	priq_destroy( q, NULL );
+
+	for( int c = 1; c < T12_CLONES; c += 2)
+	{
+		uint64_t last = 0;
+		while( !priq_is_empty( clones[c] ) )
+		{
+			uint64_t * get = priq_dequeue( clones[c] );
+			if( last > *get ) {
+				perr( "T12: priq_clone: clone order failed" ); return; }
+			last = *get;
+		}
+		priq_destroy( clones[c], NULL );
+	}
+
+	pinfo( "T12: priq_clone path copying test successful" );
+}
+
+#define T13_SIZE 5000
+
+struct item
+{
+	uint64_t key;
+	bool dead;
+	uint64_t released;
+};
+
+struct item items[3 * T13_SIZE + 200];
+
+int item_cmp( void* e1, void* e2 )
+{
+	struct item * i1 = e1;
+	struct item * i2 = e2;
+
+	return ( ( i1->key >= i2->key ) - ( i2->key >= i1->key ) );
+}
+
+bool item_dead( void* e )
+{
+	return ((struct item *)e)->dead;
+}
+
+void item_release( void* e )
+{
+	((struct item *)e)->released++;
+}
+
+void t_13(void)
+{
+	Priq q = priq_create( item_cmp );
+	Priq qs = priq_create_backend( item_cmp, PRIQ_BACKEND_SEQUENCE );
+	Priq qt = priq_create( item_cmp );
+	uint64_t n = 0;
+
+	for( uint64_t i = 0; i < T13_SIZE; ++i)
+	{
+		for( int k = 0; k < 3; ++k)
+		{
+			struct item * it = items + n++;
+			it->key = rand() % 1000;
+			it->dead = ( it->key % 3 == 0 );
+			it->released = 0;
+			priq_enqueue( k == 0 ? q : k == 1 ? qs : qt, it );
+		}
+	}
+
+	Priq cl = priq_clone( q );
+
+	uint64_t r1 = priq_remove_if( q, item_dead, item_release );
+	uint64_t r2 = priq_remove_if( qs, item_dead, item_release );
+
+	// the clone must still see every element
+	if( priq_size( cl ) != T13_SIZE || priq_invariant( cl ) ) {
+		perr( "T13: priq_remove_if: clone changed" ); return; }
+	priq_destroy( cl, NULL );
+
+	uint64_t released = 0;
+	for( uint64_t i = 0; i < n; ++i)
+	{
+		released += items[i].released;
+		if( items[i].released > 1 || ( items[i].released && !items[i].dead ) ) {
+			perr( "T13: priq_remove_if: wrong element released" ); return; }
+	}
+	if( released != r1 + r2 ) {
+		perr( "T13: priq_remove_if: released %lu, removed %lu", released, r1 + r2 ); return; }
+
+	Priq all[2] = { q, qs };
+	uint64_t removed[2] = { r1, r2 };
+	for( int k = 0; k < 2; ++k)
+	{
+		const char* msg = priq_invariant( all[k] );
+		if(msg) {
+			perr( "T13: priq_remove_if: invariant failed: %s", msg ); return; }
+
+		if( priq_size( all[k] ) + removed[k] != T13_SIZE ) {
+			perr( "T13: priq_remove_if: size mismatch" ); return; }
+
+		uint64_t last = 0;
+		while( !priq_is_empty( all[k] ) )
+		{
+			struct item * it = priq_dequeue( all[k] );
+			if( it->dead || last > it->key ) {
+				perr( "T13: priq_remove_if: dead or unordered element left" ); return; }
+			last = it->key;
+		}
+		priq_destroy( all[k], NULL );
+	}
+
+	// tombstones: dequeue skips, mark_dead compacts
+	priq_tombstones( qt, item_dead, item_release, 0.25 );
+	priq_mark_dead( qt, T13_SIZE / 5 );
+	if( priq_size( qt ) != T13_SIZE ) {
+		perr( "T13: priq_mark_dead: compacted too early" ); return; }
+	priq_mark_dead( qt, T13_SIZE / 5 );
+	if( priq_size( qt ) == T13_SIZE ) {
+		perr( "T13: priq_mark_dead: not compacted" ); return; }
+
+	for( int i = 0; i < 100; ++i)
+	{
+		struct item * it = items + n++;
+		it->key = rand() % 1000;
+		it->dead = false;
+		priq_enqueue( qt, it );
+		((struct item *)priq_peek( qt ))->dead = true;
+	}
+
+	uint64_t last = 0;
+	while( !priq_is_empty( qt ) )
+	{
+		struct item * it = priq_dequeue( qt );
+		if( !it )
+			break;
+		if( it->dead || last > it->key ) {
+			perr( "T13: tombstones: dead or unordered element returned" ); return; }
+		last = it->key;
+	}
+
+	// a clone keeps the mode, both queues release every dead element once
+	uint64_t first = n;
+	for( int i = 0; i < 100; ++i)
+	{
+		struct item * it = items + n++;
+		it->key = rand() % 1000;
+		it->dead = false;
+		it->released = 0;
+		priq_enqueue( qt, it );
+	}
+	Priq ct = priq_clone( qt );
+	for( uint64_t i = first; i < n; i += 2)
+		items[i].dead = true;
+
+	Priq both[2] = { qt, ct };
+	for( int k = 0; k < 2; ++k)
+	{
+		last = 0;
+		while( !priq_is_empty( both[k] ) )
+		{
+			struct item * it = priq_dequeue( both[k] );
+			if( !it )
+				break;
+			if( it->dead || last > it->key ) {
+				perr( "T13: tombstones: dead or unordered element returned" ); return; }
+			last = it->key;
+		}
+	}
+	for( uint64_t i = first; i < n; ++i)
+		if( items[i].released != ( items[i].dead ? 2 : 0 ) ) {
+			perr( "T13: tombstones: clone released %lu times", items[i].released ); return; }
+
+	priq_destroy( qt, NULL );
+	priq_destroy( ct, NULL );
+
+	pinfo( "T13: priq_remove_if & tombstones test successful" );
+}
+void t_14(void)
+{
+	for( uint64_t round = 0; round < 200; ++round)
+	{
+		Priq q = priq_create( icompare );
+		priq_insertion_buffer( q, 1 + rand() % PRIQ_IBUF_MAX );
+
+		// mostly new minimums, some random
+		uint64_t low = TEST_ARRAY_SIZE / 2;
+		for( uint64_t i = 0; i < 500; ++i)
+		{
+			if( rand() % 3 && low )
+				priq_enqueue( q, a + --low );
+			else
+				priq_enqueue( q, a + (rand() % TEST_ARRAY_SIZE));
+			if( rand() % 4 == 0 )
+				priq_dequeue( q );
+		}
+
+		const char* msg = priq_invariant(q);
+		if(msg) {
+			perr( "T14: insertion buffer: invariant failed: %s", msg ); return; }
+
+		Priq cl = priq_clone( q );
+		Priq out = priq_create( icompare );
+		priq_split( q, out );
+		q = priq_merge( out, q );
+
+		Priq all[2] = { q, cl };
+		for( int k = 0; k < 2; ++k)
+		{
+			uint64_t last = 0;
+			while( !priq_is_empty( all[k] ) )
+			{
+				uint64_t * peek = priq_peek( all[k] );
+				uint64_t * get = priq_dequeue( all[k] );
+				if( peek != get || last > *get ) {
+					perr( "T14: insertion buffer: wrong order" ); return; }
+				last = *get;
+			}
+			priq_destroy( all[k], NULL );
+		}
+	}
+
+	Priq q = priq_create_backend( icompare, PRIQ_BACKEND_SEQUENCE );
+	if( priq_insertion_buffer( q, 16 ) ) {
+		perr( "T14: insertion buffer: accepted by sequence heap" ); return; }
+	priq_destroy( q, NULL );
+
+	pinfo( "T14: insertion buffer test successful" );
+}
+
+bool is_odd( void* e )
+{
+	return *(uint64_t*)e & 1;
+}
+
+void t_15(void)
+{
+	static uint64_t count[1000];
+	Priq q = priq_create_backend( icompare, PRIQ_BACKEND_INTERVAL );
+
+	for( uint64_t i = 0; i < 1000; ++i)
+		count[i] = 0;
+
+	// random mix checked against counts, keys with duplicates
+	for( uint64_t i = 0; i < 20000; ++i)
+	{
+		int op = rand() % 5;
+		if( op < 3 || priq_is_empty( q ) )
+		{
+			uint64_t k = rand() % 1000;
+			priq_enqueue( q, a + k );
+			count[k]++;
+			continue;
+		}
+
+		uint64_t want = ( op == 3 ) ? 0 : 999;
+		while( !count[want] )
+			want += ( op == 3 ) ? 1 : -1;
+
+		uint64_t * peek = ( op == 3 ) ? priq_peek_min( q ) : priq_peek_max( q );
+		uint64_t * get = ( op == 3 ) ? priq_dequeue_min( q ) : priq_dequeue_max( q );
+		if( peek != get || *get != want ) {
+			perr( "T15: interval heap: wrong element %lu, expected %lu",
+				(unsigned long)*get, (unsigned long)want ); return; }
+		count[want]--;
+
+		if( i % 1000 == 0 && priq_invariant( q ) ) {
+			perr( "T15: interval heap: invariant failed: %s", priq_invariant( q ) ); return; }
+	}
+
+	Priq out = priq_create_backend( icompare, PRIQ_BACKEND_INTERVAL );
+	priq_split( q, out );
+	if( priq_invariant( q ) || priq_invariant( out ) ) {
+		perr( "T15: interval heap: invariant failed after split" ); return; }
+	q = priq_merge( out, q );
+
+	uint64_t n = priq_size( q );
+	uint64_t removed = priq_remove_if( q, is_odd, NULL );
+	if( priq_invariant( q ) || priq_size( q ) != n - removed ) {
+		perr( "T15: interval heap: remove_if failed" ); return; }
+
+	// drain from both ends
+	uint64_t lo = 0;
+	uint64_t hi = 999;
+	for( int k = 0; !priq_is_empty( q ); ++k)
+	{
+		uint64_t * get = ( k & 1 ) ? priq_dequeue_max( q ) : priq_dequeue_min( q );
+		if( *get & 1 || ( k & 1 ? *get > hi : *get < lo ) ) {
+			perr( "T15: interval heap: wrong order" ); return; }
+		if( k & 1 )
+			hi = *get;
+		else
+			lo = *get;
+	}
+	if( lo > hi || priq_dequeue_max( q ) || priq_peek_max( q ) ) {
+		perr( "T15: interval heap: not empty" ); return; }
+	priq_destroy( q, NULL );
+
+	// other backends refuse, and keep their elements
+	for( int k = 0; k < 3; ++k )
+	{
+		Pribackend other[] = { PRIQ_BACKEND_SKEW, PRIQ_BACKEND_SEQUENCE, PRIQ_BACKEND_LEFTIST };
+		q = priq_create_backend( icompare, other[k] );
+		priq_enqueue( q, a );
+		if( priq_peek_max( q ) || priq_dequeue_max( q ) || priq_size( q ) != 1 ) {
+			perr( "T15: interval heap: max on backend %d", (int)other[k] ); return; }
+		priq_destroy( q, NULL );
+	}
+
+	pinfo( "T15: interval heap test successful" );
+}
+
+struct shm_rec
+{
+	uint64_t key;
+	uint32_t producer;
+	uint32_t seq;
+};
+
+int shm_compare( void* e1, void* e2 )
+{
+	const struct shm_rec* r1 = e1;
+	const struct shm_rec* r2 = e2;
+
+	return ( ( r1->key >= r2->key ) - ( r2->key >= r1->key ) );
+}
+
+// waits for a child, true if it exited with 0
+static bool shm_wait( pid_t pid )
+{
+	int status;
+	return waitpid( pid, &status, 0 ) == pid && WIFEXITED( status ) && !WEXITSTATUS( status );
+}
+
+void t_16(void)
+{
+	char name[64];
+	snprintf( name, sizeof( name ), "/priq-test-%d", (int)getpid() );
+
+	PriqShm q = priq_shm_create( name, sizeof( struct shm_rec ), 4096, shm_compare );
+	if( !q ) {
+		perr( "T16: shared memory: create failed" ); return; }
+	PriqShm twice = priq_shm_create( name, sizeof( struct shm_rec ), 4096, shm_compare );
+	if( twice ) {
+		priq_shm_close( twice );
+		perr( "T16: shared memory: created twice" ); goto cleanup; }
+
+	// producers
+	pid_t pids[4];
+	for( uint32_t p = 0; p < 4; ++p)
+	{
+		if( ( pids[p] = fork() ) == 0 )
+		{
+			PriqShm c = priq_shm_open( name, shm_compare );
+			srand( getpid() );
+			for( uint32_t i = 0; c && i < 500; ++i)
+			{
+				struct shm_rec r = { rand() % 1000, p, i };
+				if( !priq_shm_enqueue( c, &r ) )
+					_exit( 1 );
+			}
+			_exit( c ? 0 : 1 );
+		}
+	}
+	for( int p = 0; p < 4; ++p)
+		if( !shm_wait( pids[p] ) ) {
+			perr( "T16: shared memory: producer failed" ); goto cleanup; }
+
+	const char* msg = NULL;
+	uint64_t last = 0;
+	struct shm_rec r = { 0, 0, 0 };
+	struct shm_rec peek;
+
+	msg = priq_shm_invariant( q );
+	if( msg || priq_shm_size( q ) != 2000 ) {
+		perr( "T16: shared memory: after producers: %s", msg ? msg : "wrong size" ); goto cleanup; }
+
+	// consumers, every one sees its records in order
+	for( int p = 0; p < 2; ++p)
+	{
+		if( ( pids[p] = fork() ) == 0 )
+		{
+			PriqShm c = priq_shm_open( name, shm_compare );
+			struct shm_rec r;
+			uint64_t last = 0;
+			while( c && priq_shm_dequeue( c, &r ) )
+			{
+				if( r.key < last )
+					_exit( 1 );
+				last = r.key;
+			}
+			_exit( c ? 0 : 1 );
+		}
+	}
+	for( int p = 0; p < 2; ++p)
+		if( !shm_wait( pids[p] ) ) {
+			perr( "T16: shared memory: consumer failed" ); goto cleanup; }
+
+	if( priq_shm_size( q ) ) {
+		perr( "T16: shared memory: not empty" ); goto cleanup; }
+
+	// a process killed while working on the queue
+	pid_t pid = fork();
+	if( pid == 0 )
+	{
+		PriqShm c = priq_shm_open( name, shm_compare );
+		struct shm_rec r = { 0, 0, 0 };
+		for( ;; )
+		{
+			r.key = ( r.key * 7 + 3 ) % 1000;
+			if( !priq_shm_enqueue( c, &r ) )
+				priq_shm_dequeue( c, &r );
+		}
+	}
+	struct timespec ts = { 0, 20 * 1000 * 1000 };
+	nanosleep( &ts, NULL );
+	kill( pid, SIGKILL );
+	waitpid( pid, NULL, 0 );
+
+	msg = priq_shm_invariant( q );
+	if( msg ) {
+		perr( "T16: shared memory: after kill: %s", msg ); goto cleanup; }
+
+	// fill up, then drain in order
+	while( priq_shm_enqueue( q, &r ) )
+		r.key = rand() % 1000;
+	if( priq_shm_size( q ) != 4096 || errno != ENOSPC ) {
+		perr( "T16: shared memory: capacity not reached" ); goto cleanup; }
+
+	while( priq_shm_peek( q, &peek ) )
+	{
+		priq_shm_dequeue( q, &r );
+		if( r.key < last || r.key != peek.key ) {
+			perr( "T16: shared memory: wrong order" ); goto cleanup; }
+		last = r.key;
+	}
+	if( priq_shm_dequeue( q, &r ) || errno != ENOMSG ) {
+		perr( "T16: shared memory: dequeue on empty queue" ); goto cleanup; }
+
+	priq_shm_close( q );
+	if( priq_shm_unlink( name ) || priq_shm_open( name, shm_compare ) ) {
+		perr( "T16: shared memory: unlink failed" ); return; }
+
+	pinfo( "T16: shared memory test successful" );
+	return;
+
+cleanup:
+	priq_shm_close( q );
+	priq_shm_unlink( name );
+}
+
+void t_17(void)
+{
+	for( uint64_t round = 0; round < 50; ++round)
+	{
+		Priq q = priq_create_backend( icompare, PRIQ_BACKEND_LEFTIST );
+		Priq o = priq_create_backend( icompare, PRIQ_BACKEND_LEFTIST );
+		if( round & 1 )
+			priq_insertion_buffer( q, 16 );
+
+		// ascending, descending and random keys
+		for( uint64_t i = 0; i < 1000; ++i)
+		{
+			uint64_t k = ( round % 3 == 0 ) ? i : ( round % 3 == 1 ) ? 999 - i : (uint64_t)( rand() % 1000 );
+			priq_enqueue( ( i & 1 ) ? q : o, a + k );
+			if( rand() % 8 == 0 )
+				priq_dequeue( q );
+		}
+
+		q = priq_merge( q, o );
+		Priq cl = priq_clone( q );
+		o = priq_create_backend( icompare, PRIQ_BACKEND_LEFTIST );
+		priq_split( q, o );
+		priq_remove_if( cl, is_odd, NULL );
+
+		Priq all[3] = { q, o, cl };
+		for( int k = 0; k < 3; ++k)
+		{
+			const char* msg = priq_invariant( all[k] );
+			if( msg ) {
+				perr( "T17: leftist heap: invariant failed: %s", msg ); return; }
+
+			uint64_t last = 0;
+			while( !priq_is_empty( all[k] ) )
+			{
+				uint64_t * get = priq_dequeue( all[k] );
+				if( last > *get || ( k == 2 && *get & 1 ) ) {
+					perr( "T17: leftist heap: wrong order" ); return; }
+				last = *get;
+			}
+			priq_destroy( all[k], NULL );
+		}
+	}
+
+	pinfo( "T17: leftist heap test successful" );
+}
 
 
 int main( void )
@@ -391,6 +1170,15 @@ int main( void )
 	tests[6] = t_06;
 	tests[7] = t_07;
 	tests[8] = t_08;
+	tests[9] = t_09;
+	tests[10] = t_10;
+	tests[11] = t_11;
+	tests[12] = t_12;
+	tests[13] = t_13;
+	tests[14] = t_14;
+	tests[15] = t_15;
+	tests[16] = t_16;
+	tests[17] = t_17;
 
 	for ( int i = 0; i < TEST_FUNC_ARRAY_SIZE ; ++i )
 		if( tests[i] )